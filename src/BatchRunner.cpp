@@ -0,0 +1,166 @@
+#include "BatchRunner.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <sys/resource.h>
+
+namespace {
+
+/**
+ * Peak resident set size of the whole process in KiB. This is the maximum over the process lifetime so far, shared by
+ * all concurrently solved instances, so it is not attributable to the instance it is reported with.
+ */
+long get_peak_memory_kib() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+}
+
+BatchRunner::BatchRunner(InstanceSolver solver, std::size_t const num_threads) :
+    _solver(std::move(solver)), _num_threads(num_threads) {}
+
+void BatchRunner::read_solutions(std::filesystem::path const& solutions_file) {
+    std::ifstream in(solutions_file);
+    if (not in) {
+        std::cerr << "Failed to open " << solutions_file << '\n';
+        return;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream line_stream(line);
+        std::string name;
+        Cost cost;
+        // Lines not of the form "<name> <cost>" are descriptions
+        if (line_stream >> name >> cost) {
+            _known_solutions[normalized_name(name)] = cost;
+        }
+    }
+}
+
+std::optional<std::vector<BatchRunner::Instance>> BatchRunner::collect_instances(std::filesystem::path const& path) {
+    std::vector<Instance> result;
+    if (path.extension() == ".sdtg" or path.extension() == ".sdtb") {
+        add_instances(path, result);
+    } else if (std::filesystem::is_directory(path)) {
+        std::vector<std::filesystem::path> files;
+        for (auto const& entry : std::filesystem::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() and entry.path().extension() == ".sdtg") {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        for (auto const& file : files) {
+            add_instances(file, result);
+        }
+    } else {
+        std::ifstream in(path);
+        if (not in.is_open()) {
+            std::cerr << "Failed to open instance list " << path << '\n';
+            return std::nullopt;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (not line.empty()) {
+                add_instances(path.parent_path() / line, result);
+            }
+        }
+    }
+    return result;
+}
+
+void BatchRunner::add_instances(std::filesystem::path const& path, std::vector<Instance>& instances) {
+    if (path.extension() != ".sdtb") {
+        instances.push_back({path});
+        return;
+    }
+    auto file = BinaryInstanceFile::open(path);
+    if (not file.has_value()) {
+        // Reported as READ_FAILED by run
+        instances.push_back({path});
+        return;
+    }
+    auto const shared_file = std::make_shared<BinaryInstanceFile const>(std::move(file.value()));
+    for (std::size_t index = 0; index < shared_file->size(); ++index) {
+        instances.push_back({std::filesystem::path(shared_file->get_name(index)), shared_file, index});
+    }
+}
+
+std::optional<std::vector<Point>> BatchRunner::read_instance(Instance const& instance) {
+    if (instance.binary_file != nullptr) {
+        auto const terminals = instance.binary_file->get_terminals(instance.binary_index);
+        return std::vector<Point>(terminals.begin(), terminals.end());
+    }
+    if (instance.path.extension() == ".sdtb") {
+        return std::nullopt;
+    }
+    std::ifstream in(instance.path);
+    return read_terminals(in);
+}
+
+bool BatchRunner::run(std::vector<Instance> const& instances, std::ostream& out) {
+    std::mutex output_mutex;
+    bool all_ok = true;
+    out << "instance\tcost\tseconds\tlabel_memory_bytes\tpeak_process_memory_kib\tstatus\n";
+    ThreadPool pool(_num_threads);
+    pool.parallel_for(
+        instances.size(), [&](std::size_t const instance_index) {
+            auto const& instance = instances.at(instance_index);
+            auto const& path = instance.path;
+            auto const start = std::chrono::steady_clock::now();
+            auto const terminals = read_instance(instance);
+            std::optional<SolverResult> result;
+            std::optional<std::string> error;
+            if (terminals.has_value()) {
+                try {
+                    result = _solver(terminals.value());
+                } catch (std::exception const& exception) {
+                    error = exception.what();
+                }
+            }
+            std::chrono::duration<double> const time = std::chrono::steady_clock::now() - start;
+
+            auto const status = error.has_value() ? "FAILED (" + error.value() + ")" : get_status(path, result);
+            std::lock_guard const lock(output_mutex);
+            out << path.string() << '\t';
+            if (result.has_value()) {
+                out << result->cost << '\t' << time.count() << '\t' << result->label_memory;
+            } else {
+                out << "-\t" << time.count() << "\t-";
+            }
+            out << '\t' << get_peak_memory_kib() << '\t' << status << std::endl;
+            all_ok &= not status.starts_with("WRONG") and not status.starts_with("FAILED") and status != "READ_FAILED";
+        }
+    );
+    return all_ok;
+}
+
+std::string BatchRunner::get_status(
+    std::filesystem::path const& instance, std::optional<SolverResult> const& result
+) const {
+    if (not result.has_value()) {
+        return "READ_FAILED";
+    }
+    auto const known = _known_solutions.find(normalized_name(instance.stem()));
+    if (known != _known_solutions.end() and
+        (known->second < result->lower_bound or known->second > result->cost)) {
+        return "WRONG (expected " + std::to_string(known->second) + ")";
+    } else if (result->lower_bound < result->cost) {
+        return "LIMIT (lower bound " + std::to_string(result->lower_bound) + ")";
+    } else if (known == _known_solutions.end()) {
+        return "-";
+    } else {
+        return "OK";
+    }
+}
+
+std::string BatchRunner::normalized_name(std::string name) {
+    name.erase(std::remove(name.begin(), name.end(), '_'), name.end());
+    return name;
+}
@@ -0,0 +1,93 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "HananGrid.h"
+#include "BinaryInstanceFile.h"
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Solves many instances in one process. Instances are distributed over a ThreadPool, and a line with the cost, wall
+ * time and memory usage is written for each instance as soon as it has been solved. The label memory is that of the
+ * instance itself, while the peak process memory is the high-water mark of the whole process at the time the line is
+ * written: It never decreases and includes all instances solved before or concurrently.
+ */
+class BatchRunner {
+public:
+    struct SolverResult {
+        /// The best upper bound, which is the optimum cost unless the solver stopped at a limit
+        Cost cost;
+        /// Less than cost if the solver stopped at a limit
+        Cost lower_bound;
+        /// Bytes used by the solver for storing the labels of this instance
+        std::size_t label_memory;
+    };
+
+    /// An instance of a batch, either an .sdtg file or one instance of a binary instance file
+    struct Instance {
+        /// The .sdtg file, or the name of the instance in the binary instance file
+        std::filesystem::path path;
+        /// The file containing the instance if it is binary
+        std::shared_ptr<BinaryInstanceFile const> binary_file{};
+        std::size_t binary_index = 0;
+    };
+
+    /**
+     * Solves the instance with the given terminals. Will be called concurrently from multiple threads. An exception
+     * only fails the instance it was thrown for.
+     */
+    using InstanceSolver = std::function<SolverResult(std::vector<Point> const&)>;
+
+    BatchRunner(InstanceSolver solver, std::size_t num_threads);
+
+    /**
+     * Reads the optimum costs from a file in the format of instances/solutions.txt. Instance names are compared
+     * ignoring underscores, since e.g. instances/custom/i_17.sdtg is listed as i17.
+     */
+    void read_solutions(std::filesystem::path const& solutions_file);
+
+    /**
+     * Collects the instances given by path: The path itself if it is an .sdtg file, all instances of a binary instance
+     * file (.sdtb), all .sdtg files in a directory (recursively), or all .sdtg and .sdtb files listed in a text file
+     * (one per line, relative to the list file). Returns std::nullopt if the list file cannot be opened.
+     */
+    [[nodiscard]] static std::optional<std::vector<Instance>> collect_instances(std::filesystem::path const& path);
+
+    /// The terminals of the instance, std::nullopt if they could not be read
+    [[nodiscard]] static std::optional<std::vector<Point>> read_instance(Instance const& instance);
+
+    /**
+     * Solves all given instances and writes one line per instance to out, in the order in which they are finished. An
+     * instance for which the solver throws gets the status "FAILED (...)" with the message of the exception.
+     * Returns false if any instance could not be read or solved, or a solution read from read_solutions does not
+     * match.
+     */
+    bool run(std::vector<Instance> const& instances, std::ostream& out);
+
+private:
+    /// Adds the instances of an .sdtg or .sdtb file to instances
+    static void add_instances(std::filesystem::path const& path, std::vector<Instance>& instances);
+
+    /**
+     * "OK" or "WRONG (...)" if the optimum is known, "-" if not, "READ_FAILED" if there is no result. If the solver
+     * stopped at a limit, "LIMIT (...)" with the lower bound, or "WRONG (...)" if the known optimum is not within the
+     * bounds.
+     */
+    [[nodiscard]] std::string get_status(
+        std::filesystem::path const& instance, std::optional<SolverResult> const& result
+    ) const;
+
+    [[nodiscard]] static std::string normalized_name(std::string name);
+
+    InstanceSolver _solver;
+    std::size_t _num_threads;
+    std::unordered_map<std::string, Cost> _known_solutions;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "BinaryInstanceFile.h"
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(BinaryInstanceFile::Header) == 32);
+static_assert(sizeof(BinaryInstanceFile::InstanceRecord) == 24);
+static_assert(sizeof(Point) == num_dimensions * sizeof(Coord), "Points are read from the file in place");
+
+std::optional<BinaryInstanceFile> BinaryInstanceFile::open(std::filesystem::path const& path) {
+    auto const descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        std::cerr << "Failed to open " << path << '\n';
+        return std::nullopt;
+    }
+    struct stat file_status{};
+    void* mapping = MAP_FAILED;
+    std::size_t mapping_size = 0;
+    if (fstat(descriptor, &file_status) == 0 and file_status.st_size > 0) {
+        mapping_size = static_cast<std::size_t>(file_status.st_size);
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    // The mapping stays valid after closing the file
+    close(descriptor);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map " << path << '\n';
+        return std::nullopt;
+    }
+    BinaryInstanceFile result(mapping, mapping_size);
+    if (auto const error = result.parse()) {
+        std::cerr << path << " is not a valid binary instance file: " << error.value() << '\n';
+        return std::nullopt;
+    }
+    return result;
+}
+
+bool BinaryInstanceFile::write(
+    std::filesystem::path const& path, std::vector<std::pair<std::string, std::vector<Point>>> const& instances
+) {
+    Header header;
+    std::vector<InstanceRecord> records;
+    std::string names;
+    for (auto const& [name, terminals] : instances) {
+        if (terminals.size() > max_num_terminals or
+            names.size() + name.size() > std::numeric_limits<std::uint32_t>::max()) {
+            std::cerr << "Instance " << name << " can't be stored in a binary instance file\n";
+            return false;
+        }
+        records.push_back(
+            {
+                header.num_points, static_cast<std::uint32_t>(terminals.size()),
+                static_cast<std::uint32_t>(names.size()), static_cast<std::uint32_t>(name.size())
+            }
+        );
+        header.num_points += terminals.size();
+        names += name;
+    }
+    header.num_instances = records.size();
+    header.names_size = names.size();
+
+    std::ofstream out(path, std::ios::binary);
+    auto const write_bytes = [&](void const* const data, std::size_t const num_bytes) {
+        out.write(static_cast<char const*>(data), static_cast<std::streamsize>(num_bytes));
+    };
+    write_bytes(&header, sizeof(header));
+    write_bytes(records.data(), records.size() * sizeof(InstanceRecord));
+    for (auto const& instance : instances) {
+        write_bytes(instance.second.data(), instance.second.size() * sizeof(Point));
+    }
+    write_bytes(names.data(), names.size());
+    out.close();
+    if (not out) {
+        std::cerr << "Failed to write " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+BinaryInstanceFile::BinaryInstanceFile(void* const mapping, std::size_t const mapping_size) :
+    _mapping(mapping), _mapping_size(mapping_size) {}
+
+BinaryInstanceFile::BinaryInstanceFile(BinaryInstanceFile&& other) noexcept :
+    _mapping(std::exchange(other._mapping, nullptr)),
+    _mapping_size(std::exchange(other._mapping_size, 0)),
+    _records(std::exchange(other._records, {})),
+    _points(std::exchange(other._points, {})),
+    _names(std::exchange(other._names, {})) {}
+
+BinaryInstanceFile& BinaryInstanceFile::operator=(BinaryInstanceFile&& other) noexcept {
+    std::swap(_mapping, other._mapping);
+    std::swap(_mapping_size, other._mapping_size);
+    std::swap(_records, other._records);
+    std::swap(_points, other._points);
+    std::swap(_names, other._names);
+    return *this;
+}
+
+BinaryInstanceFile::~BinaryInstanceFile() {
+    if (_mapping != nullptr) {
+        munmap(_mapping, _mapping_size);
+    }
+}
+
+std::optional<std::string> BinaryInstanceFile::parse() {
+    auto const* const bytes = static_cast<char const*>(_mapping);
+    if (_mapping_size < sizeof(Header)) {
+        return "too short";
+    }
+    auto const& header = *reinterpret_cast<Header const*>(bytes);
+    if (header.magic != Header{}.magic) {
+        return "wrong magic number";
+    }
+    if (header.version != current_version) {
+        return "unsupported version " + std::to_string(header.version);
+    }
+    // Checked one part at a time, so that none of the sizes can overflow
+    auto remaining = _mapping_size - sizeof(Header);
+    if (header.num_instances > remaining / sizeof(InstanceRecord)) {
+        return "too short for " + std::to_string(header.num_instances) + " instances";
+    }
+    remaining -= header.num_instances * sizeof(InstanceRecord);
+    if (header.num_points > remaining / sizeof(Point)) {
+        return "too short for " + std::to_string(header.num_points) + " terminals";
+    }
+    remaining -= header.num_points * sizeof(Point);
+    if (header.names_size != remaining) {
+        return "size does not match the header";
+    }
+    auto const* const records_begin = bytes + sizeof(Header);
+    auto const* const points_begin = records_begin + header.num_instances * sizeof(InstanceRecord);
+    auto const* const names_begin = points_begin + header.num_points * sizeof(Point);
+    _records = {reinterpret_cast<InstanceRecord const*>(records_begin), header.num_instances};
+    _points = {reinterpret_cast<Point const*>(points_begin), header.num_points};
+    _names = {names_begin, header.names_size};
+    for (auto const& record : _records) {
+        if (record.num_terminals > max_num_terminals or record.first_point > header.num_points or
+            record.num_terminals > header.num_points - record.first_point or
+            record.name_offset > header.names_size or record.name_length > header.names_size - record.name_offset) {
+            return "instance record out of range";
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,91 @@
+#ifndef BINARY_INSTANCE_FILE_H
+#define BINARY_INSTANCE_FILE_H
+
+#include "TypeDefs.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * A read-only view of a binary instance file (.sdtb), which stores many instances in one file. The file is mapped
+ * into memory, and the terminals of each instance are accessed in place, without parsing or copying.
+ * The file consists of four parts, all integers in native byte order:
+ * - A Header
+ * - An InstanceRecord for each instance
+ * - The terminals of all instances, as one array of Points (3 x 32 bit coordinates)
+ * - The names of all instances, concatenated without separators
+ * A file written on a machine with a different byte order is rejected because its version does not match.
+ */
+class BinaryInstanceFile {
+public:
+    static std::uint32_t constexpr current_version = 1;
+
+    struct Header {
+        std::array<char, 4> magic{'S', 'D', 'T', 'B'};
+        std::uint32_t version = current_version;
+        std::uint64_t num_instances = 0;
+        std::uint64_t num_points = 0;
+        std::uint64_t names_size = 0;
+    };
+
+    struct InstanceRecord {
+        /// Index of the first terminal in the array of Points
+        std::uint64_t first_point = 0;
+        std::uint32_t num_terminals = 0;
+        /// Position of the name in the concatenated names
+        std::uint32_t name_offset = 0;
+        std::uint32_t name_length = 0;
+        std::uint32_t reserved = 0;
+    };
+
+    /// Maps the file into memory. Prints an error and returns std::nullopt if it can't be read or is malformed.
+    [[nodiscard]] static std::optional<BinaryInstanceFile> open(std::filesystem::path const& path);
+
+    /// Writes the instances, given as pairs of name and terminals, to a new file. Returns false on failure.
+    [[nodiscard]] static bool write(
+        std::filesystem::path const& path, std::vector<std::pair<std::string, std::vector<Point>>> const& instances
+    );
+
+    BinaryInstanceFile(BinaryInstanceFile&& other) noexcept;
+
+    BinaryInstanceFile& operator=(BinaryInstanceFile&& other) noexcept;
+
+    BinaryInstanceFile(BinaryInstanceFile const&) = delete;
+
+    BinaryInstanceFile& operator=(BinaryInstanceFile const&) = delete;
+
+    ~BinaryInstanceFile();
+
+    [[nodiscard]] std::size_t size() const { return _records.size(); }
+
+    [[nodiscard]] std::string_view get_name(std::size_t const instance) const {
+        auto const& record = _records[instance];
+        return _names.substr(record.name_offset, record.name_length);
+    }
+
+    /// Points into the mapped file, valid as long as this object
+    [[nodiscard]] std::span<Point const> get_terminals(std::size_t const instance) const {
+        auto const& record = _records[instance];
+        return _points.subspan(record.first_point, record.num_terminals);
+    }
+private:
+    BinaryInstanceFile(void* mapping, std::size_t mapping_size);
+
+    /// Sets the views into the mapping and returns an error message if the contents are inconsistent
+    [[nodiscard]] std::optional<std::string> parse();
+
+    void* _mapping = nullptr;
+    std::size_t _mapping_size = 0;
+    std::span<InstanceRecord const> _records;
+    std::span<Point const> _points;
+    std::string_view _names;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#include "BatchRunner.h"
+#include "BinaryInstanceFile.h"
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Converts instances to a binary instance file, see BinaryInstanceFile. The inputs are collected as in the batch mode
+ * of DijkstraSteiner, so they may be .sdtg files, directories, list files or other binary instance files. Each
+ * instance keeps the path it was collected with as its name.
+ */
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <output.sdtb> <instance, directory or list file>...\n";
+        return 1;
+    }
+    std::vector<std::pair<std::string, std::vector<Point>>> instances;
+    for (int i = 2; i < argc; ++i) {
+        auto const collected = BatchRunner::collect_instances(argv[i]);
+        if (not collected.has_value()) {
+            return 1;
+        }
+        for (auto const& instance : collected.value()) {
+            auto terminals = BatchRunner::read_instance(instance);
+            if (not terminals.has_value()) {
+                std::cerr << "Failed to read " << instance.path << '\n';
+                return 1;
+            }
+            instances.emplace_back(instance.path.string(), std::move(terminals.value()));
+        }
+    }
+    if (not BinaryInstanceFile::write(argv[1], instances)) {
+        return 1;
+    }
+    std::cout << "Wrote " << instances.size() << " instances to " << argv[1] << '\n';
+    return 0;
+}
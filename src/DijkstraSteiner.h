@@ -5,44 +5,282 @@
 #include "HananGrid.h"
 #include "future_costs/FutureCost.h"
 #include "PrimSteinerHeuristic.h"
+#include "HeuristicPortfolio.h"
+#include "SubsetTrie.h"
+#include "ThreadPool.h"
+#include "SearchStats.h"
+#include "DistanceKernels.h"
+#include "queues/LabelQueue.h"
+#include "queues/BinaryHeapQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
+#include <string>
 #include <utility>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
 #include <cassert>
+#include <chrono>
+#include <memory>
+#include <optional>
 
-template<typename T>
-concept SubsetConsumer = requires(T a, TerminalSubset l, Cost c) {
-    a(l, c);
+/// Limits for DijkstraSteiner::solve. Unset limits do not restrict the search.
+struct SearchLimits {
+    /// Wall-clock time, measured from the start of solve
+    std::optional<std::chrono::steady_clock::duration> time{};
+    /// The number of labels taken from the queue
+    std::optional<std::size_t> num_labels{};
 };
 
-template<FutureCost FC>
+/// Bounds on the cost of an optimum Steiner tree. Both are equal to the optimum cost if the search finished.
+struct CostBounds {
+    Cost lower_bound;
+    Cost upper_bound;
+
+    [[nodiscard]] bool is_optimal() const { return lower_bound == upper_bound; }
+
+    /// The gap between the bounds relative to the upper bound
+    [[nodiscard]] double gap() const {
+        return upper_bound == 0 ? 0. : static_cast<double>(upper_bound - lower_bound) / upper_bound;
+    }
+};
+
+/**
+ * State shared by several solvers working on the same instance concurrently, see solve_with_portfolio. Each solver
+ * publishes the upper bounds it finds and adopts those of the others, and stops once stop is set. If upper_bound is
+ * already set when a solver starts, it skips the heuristics for the initial upper bound.
+ */
+struct SharedSearchState {
+    std::atomic<Cost> upper_bound = invalid_cost;
+    std::atomic<bool> stop = false;
+
+    /// Lowers upper_bound to cost if that is less
+    void offer_upper_bound(Cost const cost) {
+        auto current = upper_bound.load(std::memory_order_relaxed);
+        while (cost < current and not upper_bound.compare_exchange_weak(current, cost, std::memory_order_relaxed)) {}
+    }
+};
+
+struct SolverOptions {
+    /// If more than one thread is used, the search runs in bucket-synchronous mode, see DijkstraSteiner
+    std::size_t num_threads = 1;
+    /// Whether to store predecessors for all labels, which is required for get_tree_edges
+    bool reconstruct_tree = false;
+    /// Time budget of the heuristics computing the initial upper bound
+    std::chrono::steady_clock::duration upper_bound_time_budget = HeuristicPortfolio::default_time_budget;
+    SearchLimits limits{};
+    /// If set, a line with the current bounds is written to std::cerr in these intervals while searching
+    std::optional<std::chrono::steady_clock::duration> progress_interval{};
+    /// If set, the solver shares its upper bounds through this state and stops when requested. Must outlive the solver.
+    SharedSearchState* shared_state = nullptr;
+};
+
+/**
+ * If more than one thread is requested and the SubsetIndexer is dense, all labels with the minimum key are taken from
+ * the queue at once ("bucket-synchronous" mode): They are fixed sequentially, the candidates obtained by expanding them
+ * are computed in parallel, and then applied sequentially in the order of the fixed labels. Since candidates are
+ * computed without modifying any state, the result does not depend on the number of threads.
+ * @tparam MaxTerminals the maximum number of terminals of the instances, see terminal_widths
+ * @tparam FC the future cost used for the A*-like search
+ * @tparam Queue the priority queue used for the labels, see LabelQueue. Note that RadixHeapQueue requires the future
+ * cost to be consistent.
+ */
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue = BinaryHeapQueue>
 class DijkstraSteiner {
 public:
-    explicit DijkstraSteiner(HananGrid grid) :
+    // The types for instances with at most MaxTerminals terminals
+    using TerminalSubset = ::TerminalSubset<MaxTerminals>;
+    using Label = ::Label<MaxTerminals>;
+    using HananGrid = ::HananGrid<MaxTerminals>;
+    using GridPoint = ::GridPoint<MaxTerminals>;
+    using VertexIndex = ::VertexIndex<MaxTerminals>;
+    using Edge = std::pair<Point, Point>;
+
+    explicit DijkstraSteiner(HananGrid grid, SolverOptions const& options = {}) :
         _grid(std::move(grid)),
+        _indexer(_grid.num_non_root_terminals()),
         _future_cost{_grid, _indexer},
-        _fixed_values(_grid.num_vertices()),
-        _best_cost_bounds(_grid, _indexer, invalid_cost),
-        _fixed(_grid, _indexer, false),
+        _upper_bound_heuristics(options.upper_bound_time_budget),
+        _completion_heuristic(std::vector<Point>{}),
+        _fixed_subsets(_grid.num_vertices()),
+        _labels(_grid, _indexer, LabelRecord{}),
         _lemma_15_subsets(_indexer, TerminalSubset{0}),
         // By using half the maximum value we make sure that we can always add two entries of this map without overflow
         _lemma_15_bounds(_indexer, invalid_cost / 2),
-        _cheapest_edge_to_complement(_indexer) {}
+        _cheapest_edge_to_complement(_indexer),
+        _record_predecessors(options.reconstruct_tree),
+        _limits(options.limits),
+        _progress_interval(options.progress_interval),
+        _shared_state(options.shared_state) {
+        if (_record_predecessors) {
+            _predecessors.emplace(_grid, _indexer, Predecessor::none());
+        }
+        if (options.num_threads > 1) {
+            _thread_pool = std::make_unique<ThreadPool>(options.num_threads);
+        }
+    }
+
+    /**
+     * Searches until an optimum tree is found or one of the limits given in the options is reached. In the latter case
+     * the upper bound is the best one known at this point, i.e. from the initial heuristics or a completion of a fixed
+     * label, and the lower bound is the minimum key in the queue.
+     */
+    [[nodiscard]] CostBounds solve();
+
+    /// The upper bound returned by solve, which is the optimum cost unless a limit was reached
+    [[nodiscard]] Cost get_optimum_cost() { return solve().upper_bound; }
+
+    /// Whether the last call to solve found an optimum tree, i.e. did not stop at a limit
+    [[nodiscard]] bool found_optimum() const { return _found_optimum; }
+
+    /**
+     * Prepares the solver for a new instance. All internal containers keep their memory, so solving many instances of
+     * similar size with one solver does not allocate once the containers have grown large enough.
+     */
+    void reset(HananGrid grid);
+
+    /// Like reset(HananGrid(terminals)), but rebuilds the grid in place, so the grid's buffers are reused as well
+    void reset(std::vector<Point> const& terminals);
+
+    /**
+     * The edges of an optimum Steiner tree, in the coordinates of the instance. Each edge connects two neighboring
+     * vertices of the Hanan grid. May only be called if found_optimum, and only if reconstruct_tree was set in the
+     * options.
+     */
+    [[nodiscard]] std::vector<Edge> get_tree_edges() const;
+
+    /// The number of bytes used for storing the labels of the current instance, excluding predecessors
+    [[nodiscard]] std::size_t get_label_memory() const;
+
+    /// The number of bytes used for storing predecessors of labels (0 unless reconstruct_tree is set)
+    [[nodiscard]] std::size_t get_predecessor_memory() const;
+
+    /// The number of distinct labels for which a cost bound has been computed so far
+    [[nodiscard]] std::size_t get_num_labels() const { return _num_labels; }
 
-    [[nodiscard]] Cost get_optimum_cost();
+    /// Statistics of the last search, including those of the indexer. Empty unless DIJKSTRASTEINER_STATS is defined.
+    [[nodiscard]] SearchStats get_stats() const;
 
 private:
     struct HeapEntry {
         Cost cost_lower_bound{};
         Label label;
 
-        bool operator>(HeapEntry const& other) const {
-            return cost_lower_bound > other.cost_lower_bound;
+        [[nodiscard]] Cost key() const { return cost_lower_bound; }
+    };
+    static_assert(LabelQueue<Queue<HeapEntry>>);
+
+    /**
+     * A HeapEntry packed into 64 bits: The key in the most significant bits, followed by the global index of the vertex
+     * and the subset. The coordinates of the vertex are recomputed from its global index on extraction. Since the key
+     * of every entry is at most the upper bound at initialization, packed entries are used iff that bound fits.
+     */
+    class PackedHeapEntry {
+    public:
+        static int constexpr vertex_bits = std::bit_width(get_max_num_vertices(MaxTerminals));
+        /// Label subsets never contain the root terminal
+        static int constexpr subset_bits = MaxTerminals - 1;
+        static int constexpr key_bits = 64 - vertex_bits - subset_bits;
+
+        /// Whether all entries with keys up to max_key can be packed
+        [[nodiscard]] static bool fits(Cost const max_key) {
+            if constexpr (key_bits >= std::numeric_limits<Cost>::digits) {
+                return true;
+            } else if constexpr (key_bits <= 0) {
+                return false;
+            } else {
+                return max_key < (Cost{1} << key_bits);
+            }
+        }
+
+        PackedHeapEntry(Cost const key, Label const& label) :
+            _data(
+                (std::uint64_t{key} << key_shift) | (std::uint64_t{label.first.global_index} << subset_bits) |
+                label.second.to_ullong()
+            ) {
+            assert(fits(key) and label.second.to_ullong() <= subset_mask);
+        }
+
+        [[nodiscard]] Cost key() const { return static_cast<Cost>(_data >> key_shift); }
+
+        [[nodiscard]] VertexIndex vertex() const {
+            return static_cast<VertexIndex>((_data >> subset_bits) & vertex_mask);
         }
+
+        [[nodiscard]] TerminalSubset subset() const { return TerminalSubset{_data & subset_mask}; }
+    private:
+        /// Limited to 63 so that the shifts compile for widths which never use packed entries
+        static int constexpr key_shift = std::min(vertex_bits + subset_bits, 63);
+        static std::uint64_t constexpr vertex_mask = (std::uint64_t{1} << vertex_bits) - 1;
+        static std::uint64_t constexpr subset_mask = (std::uint64_t{1} << subset_bits) - 1;
+
+        std::uint64_t _data;
+    };
+    static_assert(LabelQueue<Queue<PackedHeapEntry>>);
+
+    /// The cost bound l(v, I) of a label and whether the label is fixed, packed into a single Cost
+    class LabelRecord {
+    public:
+        static Cost constexpr fixed_flag = Cost{1} << (std::numeric_limits<Cost>::digits - 1);
+        /// Marks records without a cost bound. All costs stored in a record are less than this.
+        static Cost constexpr no_cost = fixed_flag - 1;
+
+        [[nodiscard]] Cost cost() const { return _packed & no_cost; }
+
+        [[nodiscard]] bool has_cost() const { return cost() != no_cost; }
+
+        [[nodiscard]] bool is_fixed() const { return (_packed & fixed_flag) != 0; }
+
+        void set_cost(Cost const cost) {
+            assert(not is_fixed() and cost < no_cost);
+            _packed = cost;
+        }
+
+        void fix() { _packed |= fixed_flag; }
+    private:
+        Cost _packed = no_cost;
+    };
+
+    /**
+     * Describes how the cost bound of a label was obtained: From the label with the same subset at a neighboring
+     * vertex, by merging a fixed label with the same vertex and a disjoint subset, or not at all for the initial
+     * labels.
+     * Merged subsets only contain non-root terminals, so the bit of the root terminal is free to flag neighbors.
+     */
+    class Predecessor {
+    public:
+        using Data = std::conditional_t<(MaxTerminals <= 32), std::uint32_t, std::uint64_t>;
+        static_assert(MaxTerminals <= std::numeric_limits<Data>::digits);
+        static_assert(std::numeric_limits<VertexIndex>::digits < std::numeric_limits<Data>::digits);
+
+        static Predecessor none() { return Predecessor{0}; }
+
+        static Predecessor neighbor(VertexIndex const vertex) { return Predecessor{neighbor_flag | vertex}; }
+
+        static Predecessor merge(TerminalSubset const& merged_subset) {
+            assert(merged_subset.any());
+            return Predecessor{static_cast<Data>(merged_subset.to_ullong())};
+        }
+
+        [[nodiscard]] bool is_none() const { return _data == 0; }
+
+        [[nodiscard]] bool is_neighbor() const { return (_data & neighbor_flag) != 0; }
+
+        [[nodiscard]] bool is_merge() const { return not is_none() and not is_neighbor(); }
+
+        [[nodiscard]] VertexIndex neighbor_vertex() const { return static_cast<VertexIndex>(_data & ~neighbor_flag); }
+
+        [[nodiscard]] TerminalSubset merged_subset() const { return TerminalSubset{is_merge() ? _data : 0}; }
+    private:
+        static Data constexpr neighbor_flag = Data{1} << (std::numeric_limits<Data>::digits - 1);
+
+        explicit Predecessor(Data const data) : _data(data) {}
+
+        Data _data;
     };
 
     struct DistanceToTerminal {
@@ -50,8 +288,66 @@ private:
         TerminalIndex terminal = 0;
     };
 
+    /// A candidate for handle_candidate obtained by expanding a fixed label in bucket-synchronous mode
+    struct Candidate {
+        Label label;
+        Cost cost;
+        Predecessor predecessor;
+    };
+
+    /// Minimum number of labels per parallel task in bucket-synchronous mode
+    static std::size_t constexpr min_labels_per_task = 16;
+    /// Number of fixed labels between two attempts to improve the upper bound, see consider_for_upper_bound
+    static std::size_t constexpr upper_bound_update_interval = 512;
+    /// Number of labels taken from the queue between two checks of the time limit, progress and shared state
+    static std::size_t constexpr periodic_check_interval = 256;
+
+    using Clock = std::chrono::steady_clock;
+
+    /// Clears all search state for the instance in _grid
+    void reset_search();
+
     void init();
 
+    /// Adds an entry to _packed_heap if _use_packed_entries is set, to _heap otherwise
+    void push_entry(Cost key, Label const& label);
+
+    [[nodiscard]] HeapEntry extract_min_entry();
+
+    /// Moves all entries with the minimum key to _bucket
+    void extract_all_min_entries();
+
+    [[nodiscard]] bool queue_empty() const { return _use_packed_entries ? _packed_heap.empty() : _heap.empty(); }
+
+    [[nodiscard]] std::size_t queue_size() const { return _use_packed_entries ? _packed_heap.size() : _heap.size(); }
+
+    /// The search in sequential mode
+    [[nodiscard]] CostBounds search_sequential();
+
+    /// The search in bucket-synchronous mode
+    [[nodiscard]] CostBounds search_parallel();
+
+    /**
+     * Counts num_labels labels as taken from the queue, reports progress if it is due and exchanges upper bounds with
+     * the shared state. Returns whether the search has to stop before these labels are processed, in which case
+     * lower_bound, the minimum key in the queue before they were taken, is a lower bound on the optimum cost.
+     */
+    [[nodiscard]] bool limit_reached(std::size_t num_labels, Cost lower_bound);
+
+    /**
+     * Fixes the given label unless it is already fixed, or can be discarded by Lemma 15. Updates the fixed subsets and
+     * Lemma 15 data accordingly.
+     * @return the cost of the label if it was fixed by this call
+     */
+    [[nodiscard]] std::optional<Cost> fix_label(Label const& label);
+
+    /**
+     * Every upper_bound_update_interval fixed labels, the fixed label with the most terminals among them is completed
+     * to a Steiner tree: Its tree is joined with a Prim-Steiner tree on its vertex and the remaining terminals. The
+     * upper bound is lowered if this tree is cheaper.
+     */
+    void consider_for_upper_bound(Label const& label, Cost label_cost);
+
     /// Computes the label corresponding to the Steiner tree on all terminals
     [[nodiscard]] Label get_full_tree_label() const;
 
@@ -59,190 +355,573 @@ private:
      * Adds the given candidate to the heap unless the label is already fixed, or we can prove that the candidate can
      * not contribute to an optimum tree.
      */
-    void handle_candidate(Label const& label, Cost const& cost_to_label);
+    void handle_candidate(Label const& label, Cost const& cost_to_label, Predecessor predecessor);
 
     /**
      * Calls the consumer with each subset disjoint to base_label.second for which the label with the same special
      * vertex has already been fixed, and the cost of this label
      */
-    template<SubsetConsumer Consumer>
+    template<SubsetConsumer<MaxTerminals> Consumer>
     void for_each_disjoint_fixed_sink_set(Label const& base_label, Consumer out) const;
 
     /// Updates the data used to prune nodes based on Lemma 15 when the cost of the given label is fixed.
     void update_lemma_15_data_for(Label const& label, Cost label_cost);
 
+    /**
+     * Second type of update for the bounds used in Lemma 15, as described in Section 5: Tries to improve the bound for
+     * the union of two disjoint sets by combining their bounds. set_bound and set_lemma_15_set are the current
+     * Lemma 15 data for set.
+     */
+    void update_lemma_15_data_for_union(
+        TerminalSubset const& set, Cost set_bound, TerminalSubset const& set_lemma_15_set,
+        TerminalSubset const& other_set
+    );
+
+    /**
+     * Appends the candidates obtained from the fixed label with the given cost to out. Neighbor candidates that would
+     * be discarded by handle_candidate are left out, all merge candidates are kept since they are also used for the
+     * Lemma 15 data. Does not modify any state, so this may be called concurrently.
+     */
+    void collect_candidates(
+        Label const& label, Cost label_cost, std::vector<Candidate>& out, SearchStats& stats
+    ) const;
+
     [[nodiscard]] DistanceToTerminal get_closest_terminal_in_complement(TerminalSubset const& terminals) const;
 
-    MinHeap<HeapEntry> _heap;
-    HananGrid const _grid;
+    /// Only one of the queues is used for an instance, see PackedHeapEntry
+    Queue<HeapEntry> _heap;
+    Queue<PackedHeapEntry> _packed_heap;
+    bool _use_packed_entries = false;
+    HananGrid _grid;
     /// The indexer used for all Subset- and LabelMaps
-    SubsetIndexer _indexer;
+    SubsetIndexer<MaxTerminals> _indexer;
     FC _future_cost;
+    HeuristicPortfolio _upper_bound_heuristics;
+    /// Computes the completions in consider_for_upper_bound
+    PrimSteinerHeuristic _completion_heuristic;
+    /// The fixed label with the most terminals since the last completion, and its cost
+    std::optional<std::pair<Label, Cost>> _completion_candidate;
+    std::size_t _labels_until_completion = upper_bound_update_interval;
+    /// Buffer for the terminals of a completion
+    std::vector<Point> _completion_points;
     /// For each vertex v stores all subsets and costs I and c such that (v, I) is a fixed label with cost c
-    std::vector<std::vector<std::pair<TerminalSubset, Cost>>> _fixed_values;
-    /// l(v, I) at the current point of the algorithm
-    LabelMap<Cost> _best_cost_bounds;
-    LabelMap<bool> _fixed;
+    std::vector<SubsetTrie<MaxTerminals>> _fixed_subsets;
+    /// l(v, I) at the current point of the algorithm, and whether (v, I) is fixed
+    LabelMap<MaxTerminals, LabelRecord> _labels;
+    /// How l(v, I) was obtained. Only present if _record_predecessors is set, so cost-only runs do not allocate it.
+    std::optional<LabelMap<MaxTerminals, Predecessor>> _predecessors;
     /// The best known set S (as described in Lemma 15) for each terminal subset I
-    SubsetMap<TerminalSubset> _lemma_15_subsets;
+    SubsetMap<MaxTerminals, TerminalSubset> _lemma_15_subsets;
     /// c(H) for the subgraphs corresponding to the _lemma_15_subsets
-    SubsetMap<Cost> _lemma_15_bounds;
+    SubsetMap<MaxTerminals, Cost> _lemma_15_bounds;
     /// Stores the cost of a cheapest path from a terminal in the given set to one in the complement
-    SubsetMap<DistanceToTerminal> mutable _cheapest_edge_to_complement;
+    SubsetMap<MaxTerminals, DistanceToTerminal> mutable _cheapest_edge_to_complement;
     /// Global upper bound on the cost of a Steiner tree
     Cost _upper_cost_bound = 0;
+    std::size_t _num_labels = 0;
+    bool _record_predecessors;
+    SearchLimits _limits;
+    std::optional<Clock::duration> _progress_interval;
+    Clock::time_point _start_time;
+    Clock::time_point _next_progress_time;
+    /// The number of labels taken from the queue in the current search
+    std::size_t _num_extracted_labels = 0;
+    /// Value of _num_extracted_labels at which limit_reached checks more than the label limit next
+    std::size_t _next_periodic_check = 0;
+    SharedSearchState* _shared_state;
+    bool _found_optimum = false;
+    SearchStats _stats;
+    /// Only present if more than one thread is used
+    std::unique_ptr<ThreadPool> _thread_pool;
+    /// Buffers for bucket-synchronous mode, kept as members to reuse their memory
+    std::vector<HeapEntry> _bucket;
+    std::vector<PackedHeapEntry> _packed_bucket;
+    std::vector<std::pair<Label, Cost>> _bucket_fixed_labels;
+    std::vector<std::vector<Candidate>> _task_candidates;
+    std::vector<SearchStats> _task_stats;
 };
 
-template<FutureCost FC>
-void DijkstraSteiner<FC>::init() {
-    _upper_cost_bound = PrimSteinerHeuristic{_grid}.compute_upper_bound();
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::init() {
+    auto const timer = _stats.time(Phase::init);
+    // A bound in the shared state, like the one solve_with_portfolio computes once for all solvers, makes the
+    // heuristics redundant
+    _upper_cost_bound = invalid_cost;
+    if (_shared_state == nullptr or _shared_state->upper_bound.load(std::memory_order_relaxed) == invalid_cost) {
+        _upper_cost_bound = _upper_bound_heuristics.compute_upper_bound(
+            _grid.get_terminal_points(), _thread_pool.get()
+        );
+    }
+    if (_shared_state != nullptr) {
+        _shared_state->offer_upper_bound(_upper_cost_bound);
+        _upper_cost_bound = _shared_state->upper_bound.load(std::memory_order_relaxed);
+    }
+    if (_upper_cost_bound >= LabelRecord::no_cost) {
+        throw std::overflow_error("Upper bound " + std::to_string(_upper_cost_bound) + " is too large");
+    }
+    _use_packed_entries = PackedHeapEntry::fits(_upper_cost_bound);
+    if constexpr (PrecomputedFutureCost<FC, MaxTerminals>) {
+        _future_cost.precompute(_thread_pool.get());
+    }
     for (std::size_t terminal_id = 0; terminal_id < _grid.num_non_root_terminals(); ++terminal_id) {
         TerminalSubset terminals;
         terminals.set(terminal_id);
-        handle_candidate({_grid.get_terminals().at(terminal_id), terminals}, 0);
+        handle_candidate({_grid.get_terminals().at(terminal_id), terminals}, 0, Predecessor::none());
+    }
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::reset(HananGrid grid) {
+    _grid = std::move(grid);
+    reset_search();
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::reset(std::vector<Point> const& terminals) {
+    _grid.reset(terminals);
+    reset_search();
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::reset_search() {
+    _heap.clear();
+    _packed_heap.clear();
+    _indexer.reset(_grid.num_non_root_terminals());
+    _future_cost.reset();
+    // Tries of vertices beyond the new grid are kept for later use
+    for (auto& fixed_subsets : _fixed_subsets) {
+        fixed_subsets.clear();
     }
+    if (_fixed_subsets.size() < _grid.num_vertices()) {
+        _fixed_subsets.resize(_grid.num_vertices());
+    }
+    _labels.reset(_grid);
+    if (_predecessors.has_value()) {
+        _predecessors->reset(_grid);
+    }
+    _lemma_15_subsets.reset();
+    _lemma_15_bounds.reset();
+    _cheapest_edge_to_complement.reset();
+    _upper_cost_bound = 0;
+    _completion_candidate.reset();
+    _labels_until_completion = upper_bound_update_interval;
+    _num_labels = 0;
+    _stats.reset();
 }
 
-template<FutureCost FC>
-Label DijkstraSteiner<FC>::get_full_tree_label() const {
-    return Label{_grid.get_terminals().back(), TerminalSubset{(1ul << _grid.num_non_root_terminals()) - 1}};
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+auto DijkstraSteiner<MaxTerminals, FC, Queue>::get_full_tree_label() const -> Label {
+    auto const all_non_root_terminals = (std::uint64_t{1} << _grid.num_non_root_terminals()) - 1;
+    return Label{_grid.get_terminals().back(), TerminalSubset{all_non_root_terminals}};
 }
 
-template<FutureCost FC>
-Cost DijkstraSteiner<FC>::get_optimum_cost() {
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+CostBounds DijkstraSteiner<MaxTerminals, FC, Queue>::solve() {
+    _start_time = Clock::now();
+    _num_extracted_labels = 0;
+    _found_optimum = false;
+    // Without a time limit, progress reports or shared state, only the label limit is checked during the search
+    _next_periodic_check = std::numeric_limits<std::size_t>::max();
+    if (_limits.time.has_value() or _progress_interval.has_value() or _shared_state != nullptr) {
+        _next_periodic_check = 0;
+    }
+    if (_progress_interval.has_value()) {
+        _next_progress_time = _start_time + _progress_interval.value();
+    }
+    if (_grid.num_non_root_terminals() == 0) {
+        // A single terminal is an optimum tree without edges
+        _found_optimum = true;
+        return {0, 0};
+    }
     init();
+    if (_thread_pool and _indexer.is_dense()) {
+        return search_parallel();
+    }
+    return search_sequential();
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+bool DijkstraSteiner<MaxTerminals, FC, Queue>::limit_reached(std::size_t const num_labels, Cost const lower_bound) {
+    _num_extracted_labels += num_labels;
+    if (_limits.num_labels.has_value() and _num_extracted_labels > _limits.num_labels.value()) {
+        return true;
+    }
+    if (_num_extracted_labels < _next_periodic_check) {
+        return false;
+    }
+    _next_periodic_check = _num_extracted_labels + periodic_check_interval;
+    if (_shared_state != nullptr) {
+        if (_shared_state->stop.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        _upper_cost_bound = std::min(_upper_cost_bound, _shared_state->upper_bound.load(std::memory_order_relaxed));
+    }
+    if (not _limits.time.has_value() and not _progress_interval.has_value()) {
+        return false;
+    }
+    auto const now = Clock::now();
+    if (_progress_interval.has_value() and now >= _next_progress_time) {
+        _next_progress_time = now + _progress_interval.value();
+        std::chrono::duration<double> const elapsed = now - _start_time;
+        CostBounds const bounds{std::min(lower_bound, _upper_cost_bound), _upper_cost_bound};
+        std::cerr << "progress: " << elapsed.count() << "s, " << _num_extracted_labels << " labels, lower bound "
+                  << bounds.lower_bound << ", upper bound " << bounds.upper_bound << ", gap " << 100 * bounds.gap()
+                  << "%\n";
+    }
+    return _limits.time.has_value() and now - _start_time >= _limits.time.value();
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::push_entry(Cost const key, Label const& label) {
+    if (_use_packed_entries) {
+        _packed_heap.push(PackedHeapEntry{key, label});
+    } else {
+        _heap.push(HeapEntry{key, label});
+    }
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+auto DijkstraSteiner<MaxTerminals, FC, Queue>::extract_min_entry() -> HeapEntry {
+    if (not _use_packed_entries) {
+        return _heap.extract_min();
+    }
+    auto const entry = _packed_heap.extract_min();
+    return HeapEntry{entry.key(), Label{_grid.get_grid_point(entry.vertex()), entry.subset()}};
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::extract_all_min_entries() {
+    _bucket.clear();
+    if (not _use_packed_entries) {
+        _heap.extract_all_min(_bucket);
+        return;
+    }
+    _packed_bucket.clear();
+    _packed_heap.extract_all_min(_packed_bucket);
+    for (auto const& entry : _packed_bucket) {
+        _bucket.push_back(HeapEntry{entry.key(), Label{_grid.get_grid_point(entry.vertex()), entry.subset()}});
+    }
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+CostBounds DijkstraSteiner<MaxTerminals, FC, Queue>::search_sequential() {
     auto const stop_at_label = get_full_tree_label();
-    while (not _heap.empty()) {
-        auto const next_heap_element = _heap.top();
-        _heap.pop();
+    while (not queue_empty()) {
+        auto const next_heap_element = extract_min_entry();
         // Structured binding would be nice here, but that doesn't work nicely with
         // lambda captures
         auto const next_label = next_heap_element.label;
         if (next_label == stop_at_label) {
+            _found_optimum = true;
             // future cost is 0 here
-            return next_heap_element.cost_lower_bound;
+            return {next_heap_element.cost_lower_bound, next_heap_element.cost_lower_bound};
         }
-        auto&& is_fixed = _fixed.get_or_insert(next_label, true);
-        if (is_fixed) { continue; }
-        is_fixed = true;
-        auto const cost_here = _best_cost_bounds.get_or_default(next_label);
-        if (cost_here > _lemma_15_bounds.get_or_default(next_label.second)) { continue; }
-        update_lemma_15_data_for(next_label, cost_here);
-
-        _fixed_values.at(next_label.first.global_index).push_back({next_label.second, cost_here});
-        _grid.for_each_neighbor(
-            next_label.first, [&](GridPoint neighbor, Cost edge_cost) {
-                Label neighbor_label{neighbor, next_label.second};
-                handle_candidate(neighbor_label, edge_cost + cost_here);
-            }
-        );
+        if (limit_reached(1, next_heap_element.key())) {
+            return {std::min(next_heap_element.key(), _upper_cost_bound), _upper_cost_bound};
+        }
+        auto const optional_cost = fix_label(next_label);
+        if (not optional_cost.has_value()) { continue; }
+        auto const cost_here = optional_cost.value();
+        {
+            auto const timer = _stats.time(Phase::neighbor_expansion);
+            _grid.for_each_neighbor(
+                next_label.first, [&](GridPoint neighbor, Cost edge_cost) {
+                    Label neighbor_label{neighbor, next_label.second};
+                    handle_candidate(
+                        neighbor_label, edge_cost + cost_here, Predecessor::neighbor(next_label.first.global_index)
+                    );
+                }
+            );
+        }
+        auto const timer = _stats.time(Phase::merge_expansion);
         // Get this after running update_lemma_15_data_for, since that may improve the bound
         auto const lemma_15_bound = _lemma_15_bounds.get_or_default(next_label.second);
         auto const lemma_15_set = _lemma_15_subsets.get_or_default(next_label.second);
         for_each_disjoint_fixed_sink_set(
             next_label, [&](TerminalSubset const& other_set, Cost const other_cost) {
                 assert((other_set & next_label.second).none());
-                // Second type of update for the bounds used in Lemma 15, as described in Section 5
-                auto const other_lemma15_bound = _lemma_15_bounds.get_or_default(other_set, true);
-                auto const& other_label_15_set = _lemma_15_subsets.get_or_default(other_set);
-                auto const union_set = next_label.second | other_set;
-                auto& union_cost = _lemma_15_bounds.get_or_insert(union_set, true);
-                if (lemma_15_bound + other_lemma15_bound < union_cost and
-                    ((lemma_15_set & other_set).none() or (other_label_15_set & next_label.second).none())) {
-                    _lemma_15_subsets.get_or_insert(union_set) = (lemma_15_set | other_label_15_set) & ~union_set;
-                    union_cost = lemma_15_bound + other_lemma15_bound;
-                }
+                update_lemma_15_data_for_union(next_label.second, lemma_15_bound, lemma_15_set, other_set);
+                Label union_label{next_label.first, next_label.second | other_set};
+                handle_candidate(union_label, other_cost + cost_here, Predecessor::merge(other_set));
+            }
+        );
+    }
+    std::cerr << "Failed to find a tree, returning cost 0. This should not be possible!\n";
+    return {0, 0};
+}
 
-                Label union_label{next_label.first, union_set};
-                handle_candidate(union_label, other_cost + cost_here);
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+CostBounds DijkstraSteiner<MaxTerminals, FC, Queue>::search_parallel() {
+    auto const stop_at_label = get_full_tree_label();
+    while (not queue_empty()) {
+        extract_all_min_entries();
+        _bucket_fixed_labels.clear();
+        auto const bucket_key = _bucket.front().key();
+        auto const contains_full_tree = std::any_of(
+            _bucket.begin(), _bucket.end(), [&](HeapEntry const& entry) { return entry.label == stop_at_label; }
+        );
+        if (not contains_full_tree and limit_reached(_bucket.size(), bucket_key)) {
+            return {std::min(bucket_key, _upper_cost_bound), _upper_cost_bound};
+        }
+        for (auto const& entry : _bucket) {
+            if (entry.label == stop_at_label) {
+                _found_optimum = true;
+                return {entry.cost_lower_bound, entry.cost_lower_bound};
             }
+            if (auto const cost = fix_label(entry.label)) {
+                _bucket_fixed_labels.emplace_back(entry.label, cost.value());
+            }
+        }
+        auto const num_labels = _bucket_fixed_labels.size();
+        auto const num_tasks = std::min(
+            4 * _thread_pool->num_threads(), (num_labels + min_labels_per_task - 1) / min_labels_per_task
         );
+        if (_task_candidates.size() < num_tasks) {
+            _task_candidates.resize(num_tasks);
+            _task_stats.resize(num_tasks);
+        }
+        {
+            auto const timer = _stats.time(Phase::parallel_candidate_collection);
+            _thread_pool->parallel_for(
+                num_tasks, [&](std::size_t const task) {
+                    auto& candidates = _task_candidates[task];
+                    candidates.clear();
+                    for (auto i = task * num_labels / num_tasks; i < (task + 1) * num_labels / num_tasks; ++i) {
+                        auto const&[label, cost] = _bucket_fixed_labels[i];
+                        collect_candidates(label, cost, candidates, _task_stats[task]);
+                    }
+                }
+            );
+        }
+        auto const timer = _stats.time(Phase::parallel_candidate_reduction);
+        for (std::size_t task = 0; task < num_tasks; ++task) {
+            _stats.merge(_task_stats[task]);
+            _task_stats[task].reset();
+            for (auto const& candidate : _task_candidates[task]) {
+                if (candidate.predecessor.is_merge()) {
+                    auto const merged_subset = candidate.predecessor.merged_subset();
+                    auto const base_set = candidate.label.second & ~merged_subset;
+                    update_lemma_15_data_for_union(
+                        base_set, _lemma_15_bounds.get_or_default(base_set), _lemma_15_subsets.get_or_default(base_set),
+                        merged_subset
+                    );
+                }
+                handle_candidate(candidate.label, candidate.cost, candidate.predecessor);
+            }
+        }
     }
     std::cerr << "Failed to find a tree, returning cost 0. This should not be possible!\n";
-    return 0;
+    return {0, 0};
 }
 
-template<FutureCost FC>
-void DijkstraSteiner<FC>::handle_candidate(Label const& label, Cost const& cost_to_label) {
-    // Do not add if already above the global bound without considering future costs
-    if (cost_to_label > _upper_cost_bound) { return; }
-    if (cost_to_label > _lemma_15_bounds.get_or_default(label.second, true)) { return; }
-    auto& cost_bound = _best_cost_bounds.get_or_insert(label);
-    if (cost_to_label < cost_bound) {
-        assert(not _fixed.get_or_default(label));
-        cost_bound = cost_to_label;
-        auto const with_future_cost = cost_to_label + _future_cost(label);
-        if (with_future_cost > _upper_cost_bound) { return; }
-        _heap.push(HeapEntry{with_future_cost, label});
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+std::optional<Cost> DijkstraSteiner<MaxTerminals, FC, Queue>::fix_label(Label const& label) {
+    _stats.count(Counter::labels_popped);
+    auto& record = _labels.get_or_insert(label, true);
+    if (record.is_fixed()) {
+        _stats.count(Counter::stale_labels_popped);
+        return std::nullopt;
+    }
+    record.fix();
+    _stats.count(Counter::labels_fixed);
+    // Copy, the reference is invalidated when new labels are inserted
+    auto const cost = record.cost();
+    if (cost > _lemma_15_bounds.get_or_default(label.second)) {
+        _stats.count(Counter::fixed_labels_pruned_by_lemma_15);
+        return std::nullopt;
     }
+    update_lemma_15_data_for(label, cost);
+    _fixed_subsets.at(label.first.global_index).insert(label.second, cost);
+    consider_for_upper_bound(label, cost);
+    return cost;
 }
 
-template<FutureCost FC>
-template<SubsetConsumer Consumer>
-void DijkstraSteiner<FC>::for_each_disjoint_fixed_sink_set(Label const& base_label, Consumer const out) const {
-    auto const& base_set = base_label.second;
-    auto const disjoint_bits = _grid.num_non_root_terminals() - base_set.count();
-    auto const num_subsets = (1ul << disjoint_bits) - 1ul;
-    auto const& fixed_vector = _fixed_values.at(base_label.first.global_index);
-    auto const num_fixed_sets = fixed_vector.size();
-    // Use the set that is faster to iterate over in practice. The threshold is purely experimental.
-    if (10 * num_subsets <= num_fixed_sets) {
-        // AND-ing with this mask clears the bits we don't want in our disjoint set: Bits over the number of
-        // non-root terminals and bits already present in the base_set
-        auto const bitmask = (~base_set) & TerminalSubset{(1ul << _grid.num_non_root_terminals()) - 1ul};
-        TerminalSubset current_set;
-        do {
-            current_set |= base_set;
-            // Effectively ++current_set
-            // C++ does not define an increment operator for bitsets, and we did not consider it appropriate to add
-            // one in a header
-            // By incrementing the set ORed with the base_set, any carry out of a "block" of zero-bits in base_set
-            // is propagated to the next block of zeros.
-            {
-                auto temp = current_set.to_ulong();
-                ++temp;
-                current_set = TerminalSubset{temp};
-            }
-            current_set &= bitmask;
-            Label other_label{base_label.first, current_set};
-            // Do not call for empty set, as specified in the algorithm
-            if (current_set.any() and _fixed.get_or_default(other_label, true)) {
-                out(current_set, _best_cost_bounds.get_or_default(other_label));
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::consider_for_upper_bound(Label const& label, Cost const label_cost) {
+    if (not _completion_candidate.has_value() or
+        label.second.count() > _completion_candidate->first.second.count()) {
+        _completion_candidate.emplace(label, label_cost);
+    }
+    if (--_labels_until_completion > 0) {
+        return;
+    }
+    _labels_until_completion = upper_bound_update_interval;
+    auto const[candidate, candidate_cost] = _completion_candidate.value();
+    _completion_candidate.reset();
+    _completion_points.clear();
+    _completion_points.push_back(_grid.to_coordinates(candidate.first.indices));
+    for (TerminalIndex terminal = 0; terminal < _grid.num_terminals(); ++terminal) {
+        if (not candidate.second.test(terminal)) {
+            _completion_points.push_back(_grid.to_coordinates(_grid.get_terminals().at(terminal).indices));
+        }
+    }
+    _completion_heuristic.reset(_completion_points);
+    auto const completed_cost = candidate_cost + _completion_heuristic.compute_upper_bound();
+    if (completed_cost < _upper_cost_bound) {
+        _upper_cost_bound = completed_cost;
+        _stats.count(Counter::upper_bound_improvements);
+        if (_shared_state != nullptr) {
+            _shared_state->offer_upper_bound(completed_cost);
+        }
+    }
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::collect_candidates(
+    Label const& label, Cost const label_cost, std::vector<Candidate>& out, SearchStats& stats
+) const {
+    auto const lemma_15_bound = _lemma_15_bounds.get_or_default(label.second, true);
+    _grid.for_each_neighbor(
+        label.first, [&](GridPoint neighbor, Cost edge_cost) {
+            Label neighbor_label{neighbor, label.second};
+            auto const cost = label_cost + edge_cost;
+            if (cost > _upper_cost_bound) {
+                stats.count(Counter::candidates_pruned_by_upper_bound);
+            } else if (cost > lemma_15_bound) {
+                stats.count(Counter::candidates_pruned_by_lemma_15);
+            } else if (auto const& record = _labels.get_or_default(neighbor_label, true); cost >= record.cost()) {
+                stats.count(
+                    record.is_fixed() ? Counter::candidates_pruned_by_fixed : Counter::candidates_pruned_by_cost
+                );
+            } else {
+                out.push_back({neighbor_label, cost, Predecessor::neighbor(label.first.global_index)});
             }
-        } while (current_set.any());
+        }
+    );
+    for_each_disjoint_fixed_sink_set(
+        label, [&](TerminalSubset const& other_set, Cost const other_cost) {
+            out.push_back(
+                {{label.first, label.second | other_set}, label_cost + other_cost, Predecessor::merge(other_set)}
+            );
+        }
+    );
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+auto DijkstraSteiner<MaxTerminals, FC, Queue>::get_tree_edges() const -> std::vector<Edge> {
+    assert(_record_predecessors);
+    std::vector<Edge> result;
+    if (_grid.num_non_root_terminals() == 0) {
+        return result;
+    }
+    std::vector<Label> labels_to_visit{get_full_tree_label()};
+    while (not labels_to_visit.empty()) {
+        auto const label = labels_to_visit.back();
+        labels_to_visit.pop_back();
+        auto const predecessor = _predecessors->get_or_default(label, true);
+        if (predecessor.is_neighbor()) {
+            auto const neighbor = _grid.get_grid_point(predecessor.neighbor_vertex());
+            result.emplace_back(_grid.to_coordinates(neighbor.indices), _grid.to_coordinates(label.first.indices));
+            labels_to_visit.emplace_back(neighbor, label.second);
+        } else if (predecessor.is_merge()) {
+            auto const merged_subset = predecessor.merged_subset();
+            labels_to_visit.emplace_back(label.first, merged_subset);
+            labels_to_visit.emplace_back(label.first, label.second & ~merged_subset);
+        }
+    }
+    return result;
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+std::size_t DijkstraSteiner<MaxTerminals, FC, Queue>::get_label_memory() const {
+    return _labels.used_bytes();
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+SearchStats DijkstraSteiner<MaxTerminals, FC, Queue>::get_stats() const {
+    auto result = _stats;
+    result.merge(_indexer.get_stats());
+    return result;
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+std::size_t DijkstraSteiner<MaxTerminals, FC, Queue>::get_predecessor_memory() const {
+    return _predecessors.has_value() ? _predecessors->used_bytes() : 0;
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::handle_candidate(
+    Label const& label, Cost const& cost_to_label, Predecessor const predecessor
+) {
+    // Do not add if already above the global bound without considering future costs
+    if (cost_to_label > _upper_cost_bound) {
+        _stats.count(Counter::candidates_pruned_by_upper_bound);
+        return;
+    }
+    if (cost_to_label > _lemma_15_bounds.get_or_default(label.second, true)) {
+        _stats.count(Counter::candidates_pruned_by_lemma_15);
+        return;
+    }
+    auto& record = _labels.get_or_insert(label);
+    if (cost_to_label >= record.cost()) {
+        _stats.count(record.is_fixed() ? Counter::candidates_pruned_by_fixed : Counter::candidates_pruned_by_cost);
     } else {
-        for (auto const&[subset, cost] : fixed_vector) {
-            if ((subset & base_set).none()) {
-                out(subset, cost);
-            }
+        if (not record.has_cost()) {
+            ++_num_labels;
+        }
+        record.set_cost(cost_to_label);
+        if (_record_predecessors) {
+            _predecessors->get_or_insert(label) = predecessor;
+        }
+        auto const with_future_cost = [&] {
+            auto const timer = _stats.time(Phase::future_cost);
+            return cost_to_label + _future_cost(label);
+        }();
+        if (with_future_cost > _upper_cost_bound) {
+            _stats.count(Counter::candidates_pruned_by_future_cost);
+            return;
         }
+        push_entry(with_future_cost, label);
+        _stats.count(Counter::labels_pushed);
+        _stats.update_max_heap_size(queue_size());
     }
 }
 
-template<FutureCost FC>
-void DijkstraSteiner<FC>::update_lemma_15_data_for(Label const& label, Cost const label_cost) {
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+template<SubsetConsumer<MaxTerminals> Consumer>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::for_each_disjoint_fixed_sink_set(
+    Label const& base_label, Consumer const out
+) const {
+    _fixed_subsets.at(base_label.first.global_index).for_each_disjoint(base_label.second, out);
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::update_lemma_15_data_for(Label const& label, Cost const label_cost) {
     // Try to improve bound by replacing it with a single-vertex bound
     DistanceToTerminal cheapest = get_closest_terminal_in_complement(label.second);
-    auto const& distances = _grid.get_distances_to_terminals(label.first.global_index);
-    for_each_set_bit(
-        ~label.second, _grid.num_terminals(), [&](TerminalIndex not_contained) {
-            auto const distance = distances.at(not_contained);
-            if (distance < cheapest.distance) {
-                cheapest.distance = distance;
-                cheapest.terminal = not_contained;
-            }
-        }
+    auto const closest_to_vertex = _grid.get_distance_kernels().masked_min(
+        _grid.get_distances_to_terminals(label.first.global_index), ~label.second, _grid.num_terminals()
     );
+    if (closest_to_vertex.distance < cheapest.distance) {
+        cheapest.distance = closest_to_vertex.distance;
+        cheapest.terminal = closest_to_vertex.terminal;
+    }
     auto const new_bound = cheapest.distance + label_cost;
     auto& lemma_bound = _lemma_15_bounds.get_or_insert(label.second, true);
     if (new_bound < lemma_bound) {
         lemma_bound = new_bound;
-        _lemma_15_subsets.get_or_insert(label.second) = TerminalSubset{1ul << cheapest.terminal};
+        _lemma_15_subsets.get_or_insert(label.second) = TerminalSubset{std::uint64_t{1} << cheapest.terminal};
     }
 }
 
-template<FutureCost FC>
-auto DijkstraSteiner<FC>::get_closest_terminal_in_complement(
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+void DijkstraSteiner<MaxTerminals, FC, Queue>::update_lemma_15_data_for_union(
+    TerminalSubset const& set, Cost const set_bound, TerminalSubset const& set_lemma_15_set,
+    TerminalSubset const& other_set
+) {
+    auto const other_lemma15_bound = _lemma_15_bounds.get_or_default(other_set, true);
+    auto const& other_label_15_set = _lemma_15_subsets.get_or_default(other_set);
+    auto const union_set = set | other_set;
+    auto& union_cost = _lemma_15_bounds.get_or_insert(union_set, true);
+    if (set_bound + other_lemma15_bound < union_cost and
+        ((set_lemma_15_set & other_set).none() or (other_label_15_set & set).none())) {
+        _lemma_15_subsets.get_or_insert(union_set) = (set_lemma_15_set | other_label_15_set) & ~union_set;
+        union_cost = set_bound + other_lemma15_bound;
+    }
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC, template<class> class Queue>
+auto DijkstraSteiner<MaxTerminals, FC, Queue>::get_closest_terminal_in_complement(
     TerminalSubset const& terminals
 ) const -> DistanceToTerminal {
     auto& cheapest_edge_from_terminal_set = _cheapest_edge_to_complement.get_or_insert(terminals);
@@ -252,16 +931,13 @@ auto DijkstraSteiner<FC>::get_closest_terminal_in_complement(
     for_each_set_bit(
         terminals, _grid.num_terminals(), [&](TerminalIndex contained) {
             auto const contained_index = _grid.get_terminals().at(contained).global_index;
-            auto const& distances = _grid.get_distances_to_terminals(contained_index);
-            for_each_set_bit(
-                ~terminals, _grid.num_terminals(), [&](TerminalIndex not_contained) {
-                    auto const distance = distances.at(not_contained);
-                    if (distance < cheapest_edge_from_terminal_set.distance) {
-                        cheapest_edge_from_terminal_set.distance = distance;
-                        cheapest_edge_from_terminal_set.terminal = not_contained;
-                    }
-                }
+            auto const closest = _grid.get_distance_kernels().masked_min(
+                _grid.get_distances_to_terminals(contained_index), ~terminals, _grid.num_terminals()
             );
+            if (closest.distance < cheapest_edge_from_terminal_set.distance) {
+                cheapest_edge_from_terminal_set.distance = closest.distance;
+                cheapest_edge_from_terminal_set.terminal = closest.terminal;
+            }
         }
     );
     return cheapest_edge_from_terminal_set;
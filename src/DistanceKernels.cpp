@@ -0,0 +1,200 @@
+#include "DistanceKernels.h"
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DISTANCE_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace distance_kernels {
+
+namespace {
+
+// All kernels take the entries of the row type-erased, with the type given by Entry, so that Kernels can store
+// pointers to them
+template<TerminalIndex MaxTerminals, class Entry>
+MinimumDistance masked_min_scalar(void const* const entries, std::size_t, std::uint64_t const bits) {
+    auto const* const distances = static_cast<Entry const*>(entries);
+    MinimumDistance result;
+    for_each_set_bit(
+        TerminalSubset<MaxTerminals>{bits}, MaxTerminals, [&](TerminalIndex const terminal) {
+            if (distances[terminal] < result.distance) {
+                result.distance = distances[terminal];
+                result.terminal = terminal;
+            }
+        }
+    );
+    return result;
+}
+
+template<TerminalIndex MaxTerminals, class Entry>
+TwoSmallestDistances masked_two_smallest_scalar(void const* const entries, std::size_t, std::uint64_t const bits) {
+    auto const* const distances = static_cast<Entry const*>(entries);
+    TwoSmallestDistances result;
+    for_each_set_bit(
+        TerminalSubset<MaxTerminals>{bits}, MaxTerminals, [&](TerminalIndex const terminal) {
+            Cost const cost = distances[terminal];
+            if (cost < result.second_smallest) {
+                if (cost <= result.smallest) {
+                    result.second_smallest = result.smallest;
+                    result.smallest = cost;
+                } else {
+                    result.second_smallest = cost;
+                }
+            }
+        }
+    );
+    return result;
+}
+
+#ifdef DISTANCE_KERNELS_AVX2
+
+std::size_t constexpr num_lanes = 8;
+static_assert(sizeof(Cost) == sizeof(std::int32_t));
+static_assert(TerminalDistanceMatrix::chunk_size == num_lanes);
+
+template<TerminalIndex MaxTerminals>
+std::size_t constexpr num_chunks = (MaxTerminals + num_lanes - 1) / num_lanes;
+
+// A plain array, since std::array drops the alignment attributes of __m256i
+template<TerminalIndex MaxTerminals>
+using Chunks = __m256i[num_chunks<MaxTerminals>];
+
+__attribute__((target("avx2"))) inline __m256i load_chunk(TerminalDistanceMatrix::NarrowCost const* const entries) {
+    return _mm256_cvtepu16_epi32(_mm_load_si128(reinterpret_cast<__m128i const*>(entries)));
+}
+
+__attribute__((target("avx2"))) inline __m256i load_chunk(Cost const* const entries) {
+    return _mm256_load_si256(reinterpret_cast<__m256i const*>(entries));
+}
+
+/**
+ * Loads the distances in chunks of num_lanes 32 bit lanes, replacing the entries of terminals not in bits by
+ * invalid_cost. Rows are padded to whole chunks and aligned, so the chunks of the row can be loaded directly. The
+ * chunks beyond the row only contain terminals not in bits.
+ */
+template<TerminalIndex MaxTerminals, class Entry>
+__attribute__((target("avx2"))) void load_masked(
+    Entry const* const distances, std::size_t const row_chunks, std::uint64_t const bits, Chunks<MaxTerminals>& out
+) {
+    auto const lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    auto const all_invalid = _mm256_set1_epi32(-1);
+    for (std::size_t chunk = 0; chunk < num_chunks<MaxTerminals>; ++chunk) {
+        if (chunk >= row_chunks) {
+            out[chunk] = all_invalid;
+            continue;
+        }
+        auto const chunk_bits = _mm256_set1_epi32(static_cast<int>(bits >> (chunk * num_lanes)));
+        auto const active = _mm256_cmpeq_epi32(_mm256_and_si256(chunk_bits, lane_bits), lane_bits);
+        out[chunk] = _mm256_blendv_epi8(all_invalid, load_chunk(distances + chunk * num_lanes), active);
+    }
+}
+
+template<TerminalIndex MaxTerminals>
+__attribute__((target("avx2"))) Cost horizontal_min(Chunks<MaxTerminals> const& chunks) {
+    auto minimum = chunks[0];
+    for (std::size_t chunk = 1; chunk < num_chunks<MaxTerminals>; ++chunk) {
+        minimum = _mm256_min_epu32(minimum, chunks[chunk]);
+    }
+    auto half = _mm_min_epu32(_mm256_castsi256_si128(minimum), _mm256_extracti128_si256(minimum, 1));
+    half = _mm_min_epu32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_min_epu32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<Cost>(_mm_cvtsi128_si32(half));
+}
+
+/// Bit i of the result is set iff entry i of the chunks equals value
+template<TerminalIndex MaxTerminals>
+__attribute__((target("avx2"))) std::uint64_t equal_lanes(Chunks<MaxTerminals> const& chunks, Cost const value) {
+    auto const broadcast = _mm256_set1_epi32(static_cast<int>(value));
+    std::uint64_t result = 0;
+    for (std::size_t chunk = 0; chunk < num_chunks<MaxTerminals>; ++chunk) {
+        auto const equal = _mm256_castsi256_ps(_mm256_cmpeq_epi32(chunks[chunk], broadcast));
+        result |= static_cast<std::uint64_t>(_mm256_movemask_ps(equal)) << (chunk * num_lanes);
+    }
+    return result;
+}
+
+template<TerminalIndex MaxTerminals, class Entry>
+__attribute__((target("avx2"))) MinimumDistance masked_min_avx2(
+    void const* const entries, std::size_t const row_chunks, std::uint64_t const bits
+) {
+    Chunks<MaxTerminals> chunks;
+    load_masked<MaxTerminals>(static_cast<Entry const*>(entries), row_chunks, bits, chunks);
+    auto const minimum = horizontal_min<MaxTerminals>(chunks);
+    if (minimum == invalid_cost) {
+        return {};
+    }
+    auto const terminal = std::countr_zero(equal_lanes<MaxTerminals>(chunks, minimum));
+    return {minimum, static_cast<TerminalIndex>(terminal)};
+}
+
+template<TerminalIndex MaxTerminals, class Entry>
+__attribute__((target("avx2"))) TwoSmallestDistances masked_two_smallest_avx2(
+    void const* const entries, std::size_t const row_chunks, std::uint64_t const bits
+) {
+    Chunks<MaxTerminals> chunks;
+    load_masked<MaxTerminals>(static_cast<Entry const*>(entries), row_chunks, bits, chunks);
+    auto const minimum = horizontal_min<MaxTerminals>(chunks);
+    if (minimum == invalid_cost or std::popcount(equal_lanes<MaxTerminals>(chunks, minimum)) >= 2) {
+        return {minimum, minimum};
+    }
+    auto const all_invalid = _mm256_set1_epi32(-1);
+    auto const broadcast = _mm256_set1_epi32(static_cast<int>(minimum));
+    for (auto& chunk : chunks) {
+        chunk = _mm256_blendv_epi8(chunk, all_invalid, _mm256_cmpeq_epi32(chunk, broadcast));
+    }
+    return {minimum, horizontal_min<MaxTerminals>(chunks)};
+}
+
+bool const has_avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+
+#else
+
+bool constexpr has_avx2 = false;
+
+#endif
+
+}
+
+bool uses_avx2() {
+    return has_avx2;
+}
+
+template<TerminalIndex MaxTerminals>
+void Kernels<MaxTerminals>::select(TerminalDistanceMatrix const& matrix) {
+    _narrow = matrix.is_narrow();
+    if (_narrow) {
+        select_for_entries<TerminalDistanceMatrix::NarrowCost>();
+    } else {
+        select_for_entries<Cost>();
+    }
+}
+
+template<TerminalIndex MaxTerminals>
+template<class Entry>
+void Kernels<MaxTerminals>::select_for_entries() {
+#ifdef DISTANCE_KERNELS_AVX2
+    if (has_avx2) {
+        _masked_min = &masked_min_avx2<MaxTerminals, Entry>;
+        _masked_two_smallest = &masked_two_smallest_avx2<MaxTerminals, Entry>;
+        return;
+    }
+#endif
+    _masked_min = &masked_min_scalar<MaxTerminals, Entry>;
+    _masked_two_smallest = &masked_two_smallest_scalar<MaxTerminals, Entry>;
+}
+
+// One instantiation for each of the terminal_widths
+template class Kernels<4>;
+template class Kernels<8>;
+template class Kernels<12>;
+template class Kernels<16>;
+template class Kernels<20>;
+template class Kernels<32>;
+template class Kernels<64>;
+
+}
@@ -0,0 +1,78 @@
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+#include "TypeDefs.h"
+#include "TerminalDistanceMatrix.h"
+#include <cassert>
+#include <cstdint>
+
+/**
+ * Minimum searches over the entries of a row of a TerminalDistanceMatrix that belong to a subset of the terminals.
+ * Each kernel has an AVX2 implementation, which is used if the CPU supports it, and a scalar fallback, both for narrow
+ * and wide entries. Kernels selects the implementations once per matrix, so a call only goes through one function
+ * pointer and neither checks the entry width nor the CPU.
+ * Only the terminals with indices less than num_terminals are considered part of the subset, i.e. callers may pass
+ * the complement of a label subset directly.
+ */
+namespace distance_kernels {
+
+using DistanceRow = TerminalDistanceMatrix::Row;
+
+struct MinimumDistance {
+    /// invalid_cost if the subset is empty
+    Cost distance = invalid_cost;
+    /// The smallest terminal index with the minimum distance
+    TerminalIndex terminal = 0;
+};
+
+struct TwoSmallestDistances {
+    /// invalid_cost if the subset is empty
+    Cost smallest = invalid_cost;
+    /// Equal to smallest if the minimum is attained twice, invalid_cost if the subset has less than two elements
+    Cost second_smallest = invalid_cost;
+};
+
+/// Whether the AVX2 kernels are used
+[[nodiscard]] bool uses_avx2();
+
+/// The kernels for the rows of one TerminalDistanceMatrix
+template<TerminalIndex MaxTerminals>
+class Kernels {
+public:
+    /// Selects the implementations for the entry width of the given matrix. Call again if the matrix is reset.
+    void select(TerminalDistanceMatrix const& matrix);
+
+    [[nodiscard]] MinimumDistance masked_min(
+        DistanceRow const& distances, TerminalSubset<MaxTerminals> const& subset, std::size_t const num_terminals
+    ) const {
+        assert(distances.is_narrow() == _narrow);
+        return _masked_min(distances.data(), distances.num_chunks(), get_bits(subset, num_terminals));
+    }
+
+    [[nodiscard]] TwoSmallestDistances masked_two_smallest(
+        DistanceRow const& distances, TerminalSubset<MaxTerminals> const& subset, std::size_t const num_terminals
+    ) const {
+        assert(distances.is_narrow() == _narrow);
+        return _masked_two_smallest(distances.data(), distances.num_chunks(), get_bits(subset, num_terminals));
+    }
+private:
+    /// Arguments: The entries of the row, the number of chunks in the row, and the bits of the subset
+    using MaskedMin = MinimumDistance(*)(void const*, std::size_t, std::uint64_t);
+    using MaskedTwoSmallest = TwoSmallestDistances(*)(void const*, std::size_t, std::uint64_t);
+
+    /// Selects the implementations for rows with entries of the given type
+    template<class Entry>
+    void select_for_entries();
+
+    static std::uint64_t get_bits(TerminalSubset<MaxTerminals> const& subset, std::size_t const num_terminals) {
+        return subset.to_ullong() & get_low_bits_mask(num_terminals);
+    }
+
+    MaskedMin _masked_min = nullptr;
+    MaskedTwoSmallest _masked_two_smallest = nullptr;
+    bool _narrow = false;
+};
+
+}
+
+#endif
@@ -4,24 +4,27 @@
 #include <array>
 #include "TypeDefs.h"
 
-class HananGrid;
-
+/// A vertex of the Hanan grid of an instance with at most MaxTerminals terminals
+template<TerminalIndex MaxTerminals>
 struct GridPoint {
     using Coordinates = std::array<TerminalIndex, num_dimensions>;
 
     /// Indices of the point in the Hanan grid
     Coordinates indices;
-    /// A unique index for this vertex. This is computed as \sum_{k=1}^d a_k indices[k] for some values a_k
-    VertexIndex global_index;
+    /**
+     * A unique index for this vertex among the vertices kept by HananGrid. Within HananGrid (before vertices are
+     * removed) this is the index in the full grid, computed as \sum_{k=1}^d a_k indices[k] for some values a_k.
+     */
+    VertexIndex<MaxTerminals> global_index;
 
     /**
-     * Computes the next point in the grid along the given coordinate
+     * Computes the next point in the full grid along the given coordinate
       * @param axis_factor a_{coordinate} in the definition of global_index
       */
-    GridPoint next(std::size_t coordinate, VertexIndex axis_factor) const;
+    GridPoint next(std::size_t coordinate, VertexIndex<MaxTerminals> axis_factor) const;
 
     /// See next
-    GridPoint previous(std::size_t coordinate, VertexIndex axis_factor) const;
+    GridPoint previous(std::size_t coordinate, VertexIndex<MaxTerminals> axis_factor) const;
 
     bool operator==(GridPoint const& other) const;
 
@@ -32,23 +35,31 @@ struct GridPoint {
     Coordinates max(Coordinates const& other) const;
 };
 
-inline GridPoint GridPoint::next(std::size_t coordinate, VertexIndex axis_factor) const {
+template<TerminalIndex MaxTerminals>
+GridPoint<MaxTerminals> GridPoint<MaxTerminals>::next(
+    std::size_t coordinate, VertexIndex<MaxTerminals> axis_factor
+) const {
     auto new_indices = indices;
     ++new_indices.at(coordinate);
-    return {new_indices, static_cast<VertexIndex>(global_index + axis_factor)};
+    return {new_indices, static_cast<VertexIndex<MaxTerminals>>(global_index + axis_factor)};
 }
 
-inline GridPoint GridPoint::previous(std::size_t coordinate, VertexIndex axis_factor) const {
+template<TerminalIndex MaxTerminals>
+GridPoint<MaxTerminals> GridPoint<MaxTerminals>::previous(
+    std::size_t coordinate, VertexIndex<MaxTerminals> axis_factor
+) const {
     auto new_indices = indices;
     --new_indices.at(coordinate);
-    return {new_indices, static_cast<VertexIndex>(global_index - axis_factor)};
+    return {new_indices, static_cast<VertexIndex<MaxTerminals>>(global_index - axis_factor)};
 }
 
-inline bool GridPoint::operator==(GridPoint const& other) const {
+template<TerminalIndex MaxTerminals>
+bool GridPoint<MaxTerminals>::operator==(GridPoint const& other) const {
     return global_index == other.global_index;
 }
 
-inline GridPoint::Coordinates GridPoint::min(GridPoint::Coordinates const& other) const {
+template<TerminalIndex MaxTerminals>
+auto GridPoint<MaxTerminals>::min(Coordinates const& other) const -> Coordinates {
     Coordinates result;
     for (std::size_t i = 0; i < num_dimensions; ++i) {
         result.at(i) = std::min(indices.at(i), other.at(i));
@@ -56,7 +67,8 @@ inline GridPoint::Coordinates GridPoint::min(GridPoint::Coordinates const& other
     return result;
 }
 
-inline GridPoint::Coordinates GridPoint::max(GridPoint::Coordinates const& other) const {
+template<TerminalIndex MaxTerminals>
+auto GridPoint<MaxTerminals>::max(Coordinates const& other) const -> Coordinates {
     Coordinates result;
     for (std::size_t i = 0; i < num_dimensions; ++i) {
         result.at(i) = std::max(indices.at(i), other.at(i));
@@ -1,15 +1,26 @@
 #include "HananGrid.h"
+#include "PrimSteinerHeuristic.h"
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <istream>
 #include <stdexcept>
 #include <optional>
 #include <cassert>
 
-AxisGrid::AxisGrid(
-    std::vector<Point> const& points, std::size_t const dimension, VertexIndex index_factor
-) :
-    _index_factor(index_factor) {
+template<TerminalIndex MaxTerminals>
+AxisGrid<MaxTerminals>::AxisGrid(
+    std::vector<Point> const& points, std::size_t const dimension, VertexIndex<MaxTerminals> index_factor
+) {
+    reset(points, dimension, index_factor);
+}
+
+template<TerminalIndex MaxTerminals>
+void AxisGrid<MaxTerminals>::reset(
+    std::vector<Point> const& points, std::size_t const dimension, VertexIndex<MaxTerminals> const index_factor
+) {
+    _index_factor = index_factor;
+    _sorted_positions.clear();
     _sorted_positions.reserve(points.size());
     for (auto const& point : points) {
         _sorted_positions.push_back(point.at(dimension));
@@ -19,18 +30,133 @@ AxisGrid::AxisGrid(
     auto const last = std::unique(_sorted_positions.begin(), _sorted_positions.end());
     _sorted_positions.erase(last, _sorted_positions.end());
 
+    _differences.clear();
     _differences.reserve(_sorted_positions.size() - 1);
     for (std::size_t i = 0; i + 1 < _sorted_positions.size(); ++i) {
         _differences.push_back(_sorted_positions.at(i + 1) - _sorted_positions.at(i));
     }
 }
 
-TerminalIndex AxisGrid::index_for_coord(Coord const pos) const {
+template<TerminalIndex MaxTerminals>
+TerminalIndex AxisGrid<MaxTerminals>::index_for_coord(Coord const pos) const {
     auto const position_it = std::find(_sorted_positions.begin(), _sorted_positions.end(), pos);
     assert(position_it != _sorted_positions.end());
     return std::distance(_sorted_positions.begin(), position_it);
 }
 
+namespace {
+
+/**
+ * Lower bounds on the cost of Steiner trees containing a given non-terminal vertex v. An optimum tree has no
+ * non-terminal leaves, so v lies on the path between two distinct terminals a and b in such a tree. Two bounds are
+ * used:
+ * - Doubling the tree gives a tour through v and all terminals. Removing v from the tour leaves a path through all
+ *   terminals, so the tree costs at least (MST + d(v, a) + d(v, b)) / 2.
+ * - Every plane orthogonal to an axis between the extreme terminals is crossed by the tree. A plane between v and both
+ *   a and b is crossed twice by the path from a to b, so the tree costs at least the bounding box bound plus the
+ *   distance from v to the bounding box of a and b.
+ */
+class VertexLowerBound {
+public:
+    explicit VertexLowerBound(std::vector<Point> const& terminals) :
+        _terminals(terminals),
+        _mst_cost(compute_mst_cost(terminals)),
+        _bounding_box_cost(compute_bounding_box_cost(terminals)) {}
+
+    /**
+     * Whether every Steiner tree containing the non-terminal v costs more than upper_bound
+     * @param distances the distances from v to the terminals
+     */
+    template<std::size_t MaxTerminals>
+    [[nodiscard]] bool exceeds(
+        Point const& v, std::array<Cost, MaxTerminals> const& distances, std::uint64_t const upper_bound
+    ) const {
+        auto const num_terminals = _terminals.size();
+        TerminalIndex nearest = 0;
+        TerminalIndex second_nearest = 1;
+        if (distances.at(second_nearest) < distances.at(nearest)) {
+            std::swap(nearest, second_nearest);
+        }
+        for (TerminalIndex terminal = 2; terminal < num_terminals; ++terminal) {
+            if (distances.at(terminal) < distances.at(nearest)) {
+                second_nearest = nearest;
+                nearest = terminal;
+            } else if (distances.at(terminal) < distances.at(second_nearest)) {
+                second_nearest = terminal;
+            }
+        }
+        auto const tour_bound = _mst_cost + distances.at(nearest) + distances.at(second_nearest);
+        if (tour_bound > 2 * upper_bound) {
+            return true;
+        }
+        // Quadratic in the number of terminals, so first check whether the nearest pair already prevents removal
+        if (_bounding_box_cost + get_detour(v, nearest, second_nearest) <= upper_bound) {
+            return false;
+        }
+        for (TerminalIndex a = 0; a < num_terminals; ++a) {
+            for (TerminalIndex b = a + 1; b < num_terminals; ++b) {
+                if (_bounding_box_cost + get_detour(v, a, b) <= upper_bound) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+private:
+    /// The L1 distance from v to the bounding box of terminals a and b
+    [[nodiscard]] std::uint64_t get_detour(Point const& v, TerminalIndex const a, TerminalIndex const b) const {
+        std::uint64_t result = 0;
+        for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
+            auto const[min, max] = std::minmax(_terminals.at(a).at(dimension), _terminals.at(b).at(dimension));
+            auto const coord = v.at(dimension);
+            result += coord > max ? coord - max : (coord < min ? min - coord : 0);
+        }
+        return result;
+    }
+
+    static std::uint64_t compute_mst_cost(std::vector<Point> const& terminals) {
+        std::vector<bool> in_tree(terminals.size(), false);
+        std::vector<Cost> distance_to_tree(terminals.size(), invalid_cost);
+        std::uint64_t result = 0;
+        std::size_t next = 0;
+        distance_to_tree.at(next) = 0;
+        for (std::size_t step = 0; step < terminals.size(); ++step) {
+            in_tree.at(next) = true;
+            result += distance_to_tree.at(next);
+            std::optional<std::size_t> closest;
+            for (std::size_t other = 0; other < terminals.size(); ++other) {
+                if (in_tree.at(other)) {
+                    continue;
+                }
+                auto& distance = distance_to_tree.at(other);
+                distance = std::min(distance, get_distance(terminals.at(next), terminals.at(other)));
+                if (not closest.has_value() or distance < distance_to_tree.at(closest.value())) {
+                    closest = other;
+                }
+            }
+            next = closest.value_or(0);
+        }
+        return result;
+    }
+
+    static std::uint64_t compute_bounding_box_cost(std::vector<Point> const& terminals) {
+        std::uint64_t result = 0;
+        for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
+            auto const[min, max] = std::minmax_element(
+                terminals.begin(), terminals.end(), [&](Point const& a, Point const& b) {
+                    return a.at(dimension) < b.at(dimension);
+                }
+            );
+            result += max->at(dimension) - min->at(dimension);
+        }
+        return result;
+    }
+
+    std::vector<Point> const& _terminals;
+    std::uint64_t _mst_cost;
+    std::uint64_t _bounding_box_cost;
+};
+
 std::optional<Point> read_point(std::istream& in) {
     Point result;
     for (std::size_t i = 0; i < num_dimensions; ++i) {
@@ -42,7 +168,9 @@ std::optional<Point> read_point(std::istream& in) {
     return result;
 }
 
-std::optional<HananGrid> HananGrid::read_from_stream(std::istream& in) {
+}
+
+std::optional<std::vector<Point>> read_terminals(std::istream& in) {
     // Can't use TerminalIndex=uint8_t=unsigned char here, otherwise C++ will
     // just read the first char and give us that
     std::size_t num_terminals;
@@ -65,17 +193,30 @@ std::optional<HananGrid> HananGrid::read_from_stream(std::istream& in) {
             return std::nullopt;
         }
     }
-    return HananGrid(points);
+    return points;
+}
+
+template<TerminalIndex MaxTerminals>
+HananGrid<MaxTerminals>::HananGrid(std::vector<Point> const& terminals) {
+    reset(terminals);
 }
 
-HananGrid::HananGrid(std::vector<Point> const& terminals) {
+template<TerminalIndex MaxTerminals>
+void HananGrid<MaxTerminals>::reset(std::vector<Point> const& terminals) {
+    assert(terminals.size() <= MaxTerminals);
     VertexIndex pre_factor = 1;
     for (std::size_t dim = 0; dim < num_dimensions; ++dim) {
-        _axis_grids.at(dim) = AxisGrid(terminals, dim, pre_factor);
+        _axis_grids.at(dim).reset(terminals, dim, pre_factor);
         pre_factor *= _axis_grids.at(dim).size();
     }
+    _terminals.clear();
+    _terminal_points = terminals;
+    _full_indices.clear();
+    _vertex_coordinates.clear();
+    _neighbor_offsets.clear();
+    _neighbors.clear();
     for (auto const point : terminals) {
-        GridPoint::Coordinates coords;
+        typename GridPoint::Coordinates coords;
         VertexIndex index = 0;
         for (std::size_t dim = 0; dim < num_dimensions; ++dim) {
             coords.at(dim) = _axis_grids.at(dim).index_for_coord(point.at(dim));
@@ -83,22 +224,85 @@ HananGrid::HananGrid(std::vector<Point> const& terminals) {
         }
         _terminals.push_back({coords, index});
     }
-    GridPoint::Coordinates coords{};
-    do {
-        _vertex_terminal_distances.push_back(compute_distances_to_terminals(coords));
-    } while (next(coords));
+    remove_vertices(terminals);
+    compute_neighbors();
 }
 
-VertexIndex HananGrid::num_vertices() const {
-    VertexIndex result = 1;
+template<TerminalIndex MaxTerminals>
+void HananGrid<MaxTerminals>::compute_neighbors() {
+    _neighbor_offsets.reserve(num_vertices() + 1);
+    _neighbors.reserve(2 * num_dimensions * num_vertices());
+    auto const add_if_kept = [&](GridPoint neighbor, Cost const edge_cost) {
+        neighbor.global_index = _compact_indices.at(neighbor.global_index);
+        if (neighbor.global_index != removed_vertex) {
+            _neighbors.push_back({neighbor, edge_cost});
+        }
+    };
+    for (VertexIndex vertex = 0; vertex < num_vertices(); ++vertex) {
+        _neighbor_offsets.push_back(static_cast<std::uint32_t>(_neighbors.size()));
+        // The axis grids work on indices of the full grid
+        GridPoint const full_grid_point{_vertex_coordinates.at(vertex), _full_indices.at(vertex)};
+        for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
+            _axis_grids.at(dimension).for_each_neighbor(full_grid_point, dimension, add_if_kept);
+        }
+    }
+    _neighbor_offsets.push_back(static_cast<std::uint32_t>(_neighbors.size()));
+}
+
+template<TerminalIndex MaxTerminals>
+void HananGrid<MaxTerminals>::remove_vertices(std::vector<Point> const& terminals) {
+    std::size_t num_full_grid_vertices = 1;
     for (auto const& axis : _axis_grids) {
-        result *= axis.size();
+        num_full_grid_vertices *= axis.size();
+    }
+    _compact_indices.assign(num_full_grid_vertices, removed_vertex);
+    // No vertex of the grid is further from a terminal than the L1 diameter of the bounding box
+    std::uint64_t diameter = 0;
+    for (auto const& axis : _axis_grids) {
+        if (axis.size() > 0) {
+            diameter += axis.coord_for_index(axis.size() - 1) - axis.coord_for_index(0);
+        }
+    }
+    _vertex_terminal_distances.reset(0, num_terminals(), diameter);
+    _distance_kernels.select(_vertex_terminal_distances);
+    std::optional<VertexLowerBound> lower_bound;
+    std::uint64_t upper_bound = 0;
+    if (terminals.size() >= min_terminals_for_removal and terminals.size() <= max_terminals_for_removal) {
+        lower_bound.emplace(terminals);
+        upper_bound = PrimSteinerHeuristic(terminals).compute_upper_bound();
+    }
+    typename GridPoint::Coordinates coords{};
+    VertexIndex full_index = 0;
+    do {
+        auto const distances = compute_distances_to_terminals(coords);
+        bool keep = true;
+        if (lower_bound.has_value()) {
+            bool const is_terminal = std::find(
+                distances.begin(), distances.begin() + num_terminals(), 0
+            ) != distances.begin() + num_terminals();
+            keep = is_terminal or not lower_bound->exceeds(to_coordinates(coords), distances, upper_bound);
+        }
+        if (keep) {
+            _compact_indices.at(full_index) = static_cast<VertexIndex>(_full_indices.size());
+            _full_indices.push_back(full_index);
+            _vertex_coordinates.push_back(coords);
+            auto const row = _vertex_terminal_distances.add_row();
+            for (TerminalIndex terminal = 0; terminal < num_terminals(); ++terminal) {
+                _vertex_terminal_distances.set(row, terminal, distances.at(terminal));
+            }
+        }
+        ++full_index;
+    } while (next(coords));
+    for (auto& terminal : _terminals) {
+        terminal.global_index = _compact_indices.at(terminal.global_index);
     }
-    return result;
 }
 
-auto HananGrid::compute_distances_to_terminals(GridPoint::Coordinates from) const -> SingleVertexDistances {
-    SingleVertexDistances result;
+template<TerminalIndex MaxTerminals>
+auto HananGrid<MaxTerminals>::compute_distances_to_terminals(
+    GridPoint::Coordinates from
+) const -> SingleVertexDistances {
+    SingleVertexDistances result{};
     auto const center = to_coordinates(from);
     for (TerminalIndex other = 0; other < num_terminals(); ++other) {
         result.at(other) = get_distance(get_terminals().at(other), center);
@@ -106,11 +310,13 @@ auto HananGrid::compute_distances_to_terminals(GridPoint::Coordinates from) cons
     return result;
 }
 
-Cost HananGrid::get_distance(GridPoint const& grid_point_a, Point const& point_b) const {
-    return get_distance(to_coordinates(grid_point_a.indices), point_b);
+template<TerminalIndex MaxTerminals>
+Cost HananGrid<MaxTerminals>::get_distance(GridPoint const& grid_point_a, Point const& point_b) const {
+    return ::get_distance(to_coordinates(grid_point_a.indices), point_b);
 }
 
-bool HananGrid::next(GridPoint::Coordinates& in) const {
+template<TerminalIndex MaxTerminals>
+bool HananGrid<MaxTerminals>::next(GridPoint::Coordinates& in) const {
     for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
         ++in.at(dimension);
         if (in.at(dimension) == _axis_grids.at(dimension).size()) {
@@ -122,7 +328,7 @@ bool HananGrid::next(GridPoint::Coordinates& in) const {
     return false;
 }
 
-Cost HananGrid::get_distance(Point const& a, Point const& b) {
+Cost get_distance(Point const& a, Point const& b) {
     Cost result = 0;
     for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
         auto const[min, max] = std::minmax(a.at(dimension), b.at(dimension));
@@ -130,3 +336,20 @@ Cost HananGrid::get_distance(Point const& a, Point const& b) {
     }
     return result;
 }
+
+// One instantiation for each of the terminal_widths
+template class AxisGrid<4>;
+template class AxisGrid<8>;
+template class AxisGrid<12>;
+template class AxisGrid<16>;
+template class AxisGrid<20>;
+template class AxisGrid<32>;
+template class AxisGrid<64>;
+
+template class HananGrid<4>;
+template class HananGrid<8>;
+template class HananGrid<12>;
+template class HananGrid<16>;
+template class HananGrid<20>;
+template class HananGrid<32>;
+template class HananGrid<64>;
@@ -3,52 +3,88 @@
 
 #include "TypeDefs.h"
 #include "GridPoint.h"
+#include "TerminalDistanceMatrix.h"
+#include "DistanceKernels.h"
 #include <vector>
 #include <optional>
+#include <istream>
+#include <limits>
 
-template<class V>
-concept NeighborVisitor = requires(V v, GridPoint neighbor, Cost cost) {
+template<class V, TerminalIndex MaxTerminals>
+concept NeighborVisitor = requires(V v, GridPoint<MaxTerminals> neighbor, Cost cost) {
     v(neighbor, cost);
 };
 
 /**
  * Stores a single axis of the Hana grid. This is not intended for standalone use, but as a part of HananGrid
  */
+template<TerminalIndex MaxTerminals>
 class AxisGrid {
 public:
     AxisGrid(
-        std::vector<Point> const& points, std::size_t dimension, VertexIndex index_factor
+        std::vector<Point> const& points, std::size_t dimension, VertexIndex<MaxTerminals> index_factor
     );
 
     AxisGrid() = default;
 
+    /// Makes this the axis grid created by the constructor with these arguments, keeping the allocated memory
+    void reset(std::vector<Point> const& points, std::size_t dimension, VertexIndex<MaxTerminals> index_factor);
+
     [[nodiscard]] TerminalIndex index_for_coord(Coord pos) const;
 
     [[nodiscard]] Coord coord_for_index(TerminalIndex index) const;
 
     [[nodiscard]] std::size_t size() const { return _sorted_positions.size(); }
 
-    template<NeighborVisitor Visitor>
-    void for_each_neighbor(GridPoint here, std::size_t axis, Visitor const& visitor) const;
+    template<NeighborVisitor<MaxTerminals> Visitor>
+    void for_each_neighbor(GridPoint<MaxTerminals> here, std::size_t axis, Visitor const& visitor) const;
 
-    [[nodiscard]] VertexIndex global_index_factor() const { return _index_factor; }
+    [[nodiscard]] VertexIndex<MaxTerminals> global_index_factor() const { return _index_factor; }
 private:
     std::vector<Coord> _differences;
     std::vector<Coord> _sorted_positions;
-    VertexIndex _index_factor{};
+    VertexIndex<MaxTerminals> _index_factor{};
 };
 
+/**
+ * Reads the terminals of an instance in the .sdtg format. Fails if the instance has more than max_num_terminals
+ * terminals.
+ */
+std::optional<std::vector<Point>> read_terminals(std::istream& in);
+
+/// The L1 distance between two points
+Cost get_distance(Point const& a, Point const& b);
+
+/**
+ * The Hanan grid of an instance with at most MaxTerminals terminals. Vertices which can not be part of any optimum
+ * Steiner tree are removed on construction, together with their edges: A non-terminal vertex is removed if a lower
+ * bound on the cost of every Steiner tree containing it exceeds the cost of a Prim-Steiner tree. The remaining
+ * vertices are numbered consecutively, i.e. the global indices of all grid points are less than num_vertices.
+ * The neighbors of all kept vertices are stored in one flat array (in compressed sparse row format), so visiting them
+ * requires neither coordinate arithmetic nor checks for the border of the grid. The distances from the kept vertices
+ * to the terminals are stored in a TerminalDistanceMatrix, with 16 bits per entry for most instances.
+ */
+template<TerminalIndex MaxTerminals>
 class HananGrid {
 public:
-    using SingleVertexDistances = std::array<Cost, max_num_terminals>;
-
-    static std::optional<HananGrid> read_from_stream(std::istream& in);
+    using SingleVertexDistances = std::array<Cost, MaxTerminals>;
+    using GridPoint = ::GridPoint<MaxTerminals>;
+    using VertexIndex = ::VertexIndex<MaxTerminals>;
 
-    static Cost get_distance(Point const& a, Point const& b);
+    struct Neighbor {
+        GridPoint vertex;
+        Cost edge_cost;
+    };
 
     explicit HananGrid(std::vector<Point> const& points);
 
-    template<NeighborVisitor Visitor>
+    /**
+     * Makes this the Hanan grid of the given terminals. The containers keep their memory, so rebuilding the grid for
+     * instances of similar size does not allocate.
+     */
+    void reset(std::vector<Point> const& points);
+
+    template<NeighborVisitor<MaxTerminals> Visitor>
     void for_each_neighbor(GridPoint here, Visitor const& visitor) const;
 
     [[nodiscard]] auto const& get_terminals() const { return _terminals; }
@@ -57,26 +93,81 @@ public:
 
     [[nodiscard]] TerminalIndex num_non_root_terminals() const { return num_terminals() - 1; }
 
-    [[nodiscard]] VertexIndex num_vertices() const;
+    /// The coordinates of the terminals, in the order of get_terminals
+    [[nodiscard]] std::vector<Point> const& get_terminal_points() const { return _terminal_points; }
+
+    /// The number of vertices that were not removed
+    [[nodiscard]] VertexIndex num_vertices() const { return static_cast<VertexIndex>(_full_indices.size()); }
+
+    /// The number of vertices of the full grid that were removed on construction
+    [[nodiscard]] std::size_t num_removed_vertices() const { return _compact_indices.size() - _full_indices.size(); }
 
     [[nodiscard]] Point to_coordinates(GridPoint::Coordinates const& grid_point) const;
 
-    [[nodiscard]] SingleVertexDistances const& get_distances_to_terminals(VertexIndex from) const;
+    /// The grid point with the given global index
+    [[nodiscard]] GridPoint get_grid_point(VertexIndex const global_index) const {
+        return {_vertex_coordinates[global_index], global_index};
+    }
+
+    [[nodiscard]] TerminalDistanceMatrix::Row get_distances_to_terminals(VertexIndex from) const {
+        return _vertex_terminal_distances.row(from);
+    }
+
+    [[nodiscard]] TerminalDistanceMatrix const& get_distance_matrix() const { return _vertex_terminal_distances; }
+
+    /// The distance kernels for the rows returned by get_distances_to_terminals
+    [[nodiscard]] distance_kernels::Kernels<MaxTerminals> const& get_distance_kernels() const {
+        return _distance_kernels;
+    }
 
     [[nodiscard]] Cost get_distance(GridPoint const& point_a, Point const& point_b) const;
 
-    /// Replaces "in" with the next grid point by global index, and returns false if there isn't any
+    /// Replaces "in" with the next point of the full grid by index, and returns false if there isn't any
     [[nodiscard]] bool next(GridPoint::Coordinates& in) const;
 private:
+    /// Marks the vertices of the full grid in _compact_indices which were removed
+    static VertexIndex constexpr removed_vertex = std::numeric_limits<VertexIndex>::max();
+    /**
+     * Vertices are only removed from instances with this range of terminal counts. Two terminals span no vertex that
+     * could be removed, and from six terminals on the bounds are too weak to remove more than a few vertices in a
+     * thousand, which saves less time than the test takes.
+     */
+    static std::size_t constexpr min_terminals_for_removal = 3;
+    static std::size_t constexpr max_terminals_for_removal = 5;
+
     [[nodiscard]] SingleVertexDistances compute_distances_to_terminals(GridPoint::Coordinates from) const;
 
-    std::array<AxisGrid, num_dimensions> _axis_grids;
+    /**
+     * Computes the vertices which are kept, their distances to the terminals in _vertex_terminal_distances, and the
+     * final terminal indices
+     */
+    void remove_vertices(std::vector<Point> const& terminals);
+
+    /// Fills the neighbor arrays from the axis grids, leaving out removed vertices
+    void compute_neighbors();
+
+    std::array<AxisGrid<MaxTerminals>, num_dimensions> _axis_grids;
     std::vector<GridPoint> _terminals;
-    std::vector<SingleVertexDistances> _vertex_terminal_distances;
+    std::vector<Point> _terminal_points;
+    /// Has a row for the global index of each kept vertex
+    TerminalDistanceMatrix _vertex_terminal_distances;
+    distance_kernels::Kernels<MaxTerminals> _distance_kernels;
+    /// The index in the full grid for each kept vertex
+    std::vector<VertexIndex> _full_indices;
+    /// The indices in the Hanan grid for each kept vertex, so that labels can be stored without them
+    std::vector<typename GridPoint::Coordinates> _vertex_coordinates;
+    /// The neighbors of vertex v are _neighbors[i] for _neighbor_offsets[v] <= i < _neighbor_offsets[v + 1]
+    std::vector<std::uint32_t> _neighbor_offsets;
+    std::vector<Neighbor> _neighbors;
+    /// The global index for each vertex of the full grid, removed_vertex if the vertex was removed
+    std::vector<VertexIndex> _compact_indices;
 };
 
-template<NeighborVisitor Visitor>
-void AxisGrid::for_each_neighbor(GridPoint const here, std::size_t axis, Visitor const& visitor) const {
+template<TerminalIndex MaxTerminals>
+template<NeighborVisitor<MaxTerminals> Visitor>
+void AxisGrid<MaxTerminals>::for_each_neighbor(
+    GridPoint<MaxTerminals> const here, std::size_t axis, Visitor const& visitor
+) const {
     auto const axis_index = here.indices.at(axis);
     if (axis_index > 0) {
         visitor(here.previous(axis, _index_factor), _differences.at(axis_index - 1));
@@ -86,14 +177,17 @@ void AxisGrid::for_each_neighbor(GridPoint const here, std::size_t axis, Visitor
     }
 }
 
-template<NeighborVisitor Visitor>
-void HananGrid::for_each_neighbor(GridPoint const here, Visitor const& visitor) const {
-    for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
-        _axis_grids.at(dimension).for_each_neighbor(here, dimension, visitor);
+template<TerminalIndex MaxTerminals>
+template<NeighborVisitor<MaxTerminals> Visitor>
+void HananGrid<MaxTerminals>::for_each_neighbor(GridPoint const here, Visitor const& visitor) const {
+    auto const end = _neighbor_offsets[here.global_index + 1];
+    for (auto neighbor = _neighbor_offsets[here.global_index]; neighbor < end; ++neighbor) {
+        visitor(_neighbors[neighbor].vertex, _neighbors[neighbor].edge_cost);
     }
 }
 
-inline Point HananGrid::to_coordinates(GridPoint::Coordinates const& grid_point) const {
+template<TerminalIndex MaxTerminals>
+Point HananGrid<MaxTerminals>::to_coordinates(GridPoint::Coordinates const& grid_point) const {
     Point result;
     for (std::size_t axis = 0; axis < num_dimensions; ++axis) {
         result.at(axis) = _axis_grids.at(axis).coord_for_index(grid_point.at(axis));
@@ -101,14 +195,12 @@ inline Point HananGrid::to_coordinates(GridPoint::Coordinates const& grid_point)
     return result;
 }
 
-inline Coord AxisGrid::coord_for_index(TerminalIndex index) const {
+template<TerminalIndex MaxTerminals>
+Coord AxisGrid<MaxTerminals>::coord_for_index(TerminalIndex index) const {
     return _sorted_positions.at(index);
 }
 
-inline auto HananGrid::get_distances_to_terminals(VertexIndex const from) const -> SingleVertexDistances const& {
-    return _vertex_terminal_distances.at(from);
-}
-
-using Label = std::pair<GridPoint, TerminalSubset>;
+template<TerminalIndex MaxTerminals>
+using Label = std::pair<GridPoint<MaxTerminals>, TerminalSubset<MaxTerminals>>;
 
 #endif
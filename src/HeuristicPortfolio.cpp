@@ -0,0 +1,233 @@
+#include "HeuristicPortfolio.h"
+#include "HananGrid.h"
+#include "PrimSteinerHeuristic.h"
+#include <algorithm>
+#include <functional>
+#include <optional>
+
+namespace {
+
+/// Calls task(i) for each i < num_tasks, in parallel if a thread pool is given
+void run_tasks(
+    ThreadPool* const thread_pool, std::size_t const num_tasks, std::function<void(std::size_t)> const& task
+) {
+    if (thread_pool != nullptr) {
+        thread_pool->parallel_for(num_tasks, task);
+    } else {
+        for (std::size_t i = 0; i < num_tasks; ++i) {
+            task(i);
+        }
+    }
+}
+
+}
+
+HeuristicPortfolio::HeuristicPortfolio(Clock::duration const time_budget) : _time_budget(time_budget) {}
+
+Cost HeuristicPortfolio::compute_upper_bound(std::vector<Point> const& terminals, ThreadPool* const thread_pool) {
+    while (_prim_steiner_heuristics.size() < terminals.size()) {
+        _prim_steiner_heuristics.emplace_back(std::vector<Point>{});
+    }
+    // Prim-Steiner is optimal for up to two terminals
+    if (terminals.size() <= 2) {
+        if (terminals.empty()) {
+            return 0;
+        }
+        _prim_steiner_heuristics.front().reset(terminals);
+        return _prim_steiner_heuristics.front().compute_upper_bound();
+    }
+    auto const deadline = Clock::now() + _time_budget;
+    auto const prim_steiner_cost = run_prim_steiner(terminals, thread_pool, deadline);
+    return std::min(prim_steiner_cost, run_iterated_one_steiner(terminals, thread_pool, deadline));
+}
+
+Cost HeuristicPortfolio::SpanningTree::compute(std::vector<Point> const& points) {
+    _parents.assign(points.size(), 0);
+    _distances.assign(points.size(), invalid_cost);
+    _in_tree.assign(points.size(), false);
+    Cost result = 0;
+    std::size_t next = 0;
+    _distances.at(next) = 0;
+    for (std::size_t step = 0; step < points.size(); ++step) {
+        _in_tree.at(next) = true;
+        result += _distances.at(next);
+        std::optional<std::size_t> closest;
+        for (std::size_t other = 0; other < points.size(); ++other) {
+            if (_in_tree.at(other)) {
+                continue;
+            }
+            auto const distance = get_distance(points.at(next), points.at(other));
+            if (distance < _distances.at(other)) {
+                _distances.at(other) = distance;
+                _parents.at(other) = next;
+            }
+            if (not closest.has_value() or _distances.at(other) < _distances.at(closest.value())) {
+                closest = other;
+            }
+        }
+        next = closest.value_or(0);
+    }
+    return result;
+}
+
+Cost HeuristicPortfolio::run_prim_steiner(
+    std::vector<Point> const& terminals, ThreadPool* const thread_pool, Clock::time_point const deadline
+) {
+    _costs.assign(terminals.size(), invalid_cost);
+    run_tasks(
+        thread_pool, terminals.size(), [&](std::size_t const start_terminal) {
+            if (start_terminal == 0 or Clock::now() < deadline) {
+                auto& heuristic = _prim_steiner_heuristics.at(start_terminal);
+                heuristic.reset(terminals);
+                _costs.at(start_terminal) = heuristic.compute_upper_bound(start_terminal);
+            }
+        }
+    );
+    return *std::min_element(_costs.begin(), _costs.end());
+}
+
+Cost HeuristicPortfolio::run_iterated_one_steiner(
+    std::vector<Point> const& terminals, ThreadPool* const thread_pool, Clock::time_point const deadline
+) {
+    compute_hanan_points(terminals);
+    _points.assign(terminals.begin(), terminals.end());
+    auto cost = _tree.compute(_points);
+    while (Clock::now() < deadline) {
+        auto const& improving_points = find_improving_steiner_points(cost, thread_pool, deadline);
+        if (improving_points.empty()) {
+            break;
+        }
+        // Add the points in the order of their gains, as long as they still improve by their original gain
+        auto const round_cost = cost;
+        for (auto const&[candidate_cost, candidate] : improving_points) {
+            _points.push_back(candidate);
+            auto const new_cost = _tree.compute(_points);
+            if (new_cost + (round_cost - candidate_cost) <= cost) {
+                cost = new_cost;
+            } else {
+                _points.pop_back();
+            }
+        }
+        cost = improve_steiner_points(terminals.size());
+    }
+    return cost;
+}
+
+void HeuristicPortfolio::compute_hanan_points(std::vector<Point> const& terminals) {
+    std::size_t num_points = 1;
+    for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
+        auto& axis = _axes.at(dimension);
+        axis.clear();
+        for (auto const& terminal : terminals) {
+            axis.push_back(terminal.at(dimension));
+        }
+        std::sort(axis.begin(), axis.end());
+        axis.erase(std::unique(axis.begin(), axis.end()), axis.end());
+        num_points *= axis.size();
+    }
+    _candidates.resize(num_points);
+    for (std::size_t index = 0; index < num_points; ++index) {
+        auto remaining = index;
+        for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
+            auto const& axis = _axes.at(dimension);
+            _candidates.at(index).at(dimension) = axis.at(remaining % axis.size());
+            remaining /= axis.size();
+        }
+    }
+}
+
+std::vector<std::pair<Cost, Point>> const& HeuristicPortfolio::find_improving_steiner_points(
+    Cost const current_cost, ThreadPool* const thread_pool, Clock::time_point const deadline
+) {
+    auto const num_tasks = (_candidates.size() + candidates_per_task - 1) / candidates_per_task;
+    _costs.assign(_candidates.size(), invalid_cost);
+    if (_candidate_tasks.size() < num_tasks) {
+        _candidate_tasks.resize(num_tasks);
+    }
+    run_tasks(
+        thread_pool, num_tasks, [&](std::size_t const task) {
+            if (Clock::now() >= deadline) {
+                return;
+            }
+            auto&[tree, extended_points] = _candidate_tasks.at(task);
+            extended_points.assign(_points.begin(), _points.end());
+            extended_points.emplace_back();
+            auto const end = std::min(_candidates.size(), (task + 1) * candidates_per_task);
+            for (auto candidate = task * candidates_per_task; candidate < end; ++candidate) {
+                extended_points.back() = _candidates.at(candidate);
+                _costs.at(candidate) = tree.compute(extended_points);
+            }
+        }
+    );
+    _improving_points.clear();
+    for (std::size_t candidate = 0; candidate < _candidates.size(); ++candidate) {
+        if (_costs.at(candidate) < current_cost) {
+            _improving_points.emplace_back(_costs.at(candidate), _candidates.at(candidate));
+        }
+    }
+    std::stable_sort(
+        _improving_points.begin(), _improving_points.end(), [](auto const& a, auto const& b) {
+            return a.first < b.first;
+        }
+    );
+    return _improving_points;
+}
+
+Cost HeuristicPortfolio::improve_steiner_points(std::size_t const num_terminals) {
+    auto cost = _tree.compute(_points);
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        auto const& parents = _tree.get_parents();
+        for (auto& point_neighbors : _neighbors) {
+            point_neighbors.clear();
+        }
+        if (_neighbors.size() < _points.size()) {
+            _neighbors.resize(_points.size());
+        }
+        for (std::size_t point = 1; point < _points.size(); ++point) {
+            _neighbors.at(point).push_back(parents.at(point));
+            _neighbors.at(parents.at(point)).push_back(point);
+        }
+        // Connecting the neighbors of such a point directly is not more expensive. Erase from the back, so that the
+        // indices of the remaining points stay valid.
+        for (auto point = _points.size(); point-- > num_terminals;) {
+            if (_neighbors.at(point).size() <= 2) {
+                _points.erase(_points.begin() + static_cast<std::ptrdiff_t>(point));
+                improved = true;
+            }
+        }
+        if (improved) {
+            cost = _tree.compute(_points);
+            continue;
+        }
+        // For fixed neighbors, the sum of the distances is minimum at the median in each coordinate
+        for (auto point = num_terminals; point < _points.size() and not improved; ++point) {
+            Point median;
+            for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
+                auto& coords = _neighbor_coords;
+                coords.clear();
+                for (auto const neighbor : _neighbors.at(point)) {
+                    coords.push_back(_points.at(neighbor).at(dimension));
+                }
+                auto const middle = coords.begin() + static_cast<std::ptrdiff_t>(coords.size() / 2);
+                std::nth_element(coords.begin(), middle, coords.end());
+                median.at(dimension) = *middle;
+            }
+            if (median == _points.at(point)) {
+                continue;
+            }
+            auto const original = _points.at(point);
+            _points.at(point) = median;
+            auto const moved_cost = _tree.compute(_points);
+            if (moved_cost < cost) {
+                cost = moved_cost;
+                improved = true;
+            } else {
+                _points.at(point) = original;
+                cost = _tree.compute(_points);
+            }
+        }
+    }
+    return cost;
+}
@@ -0,0 +1,104 @@
+#ifndef HEURISTIC_PORTFOLIO_H
+#define HEURISTIC_PORTFOLIO_H
+
+#include "TypeDefs.h"
+#include "PrimSteinerHeuristic.h"
+#include "ThreadPool.h"
+#include <array>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+/**
+ * Computes an upper bound on the cost of a rectilinear Steiner tree by running several heuristics and returning the
+ * cost of the best tree found:
+ * - The PrimSteinerHeuristic, started at each terminal
+ * - Batched iterated 1-Steiner: Starting with the terminals, repeatedly computes for each point of the Hanan grid how
+ *   much adding it decreases the cost of a minimum spanning tree. The points are then added in the order of their
+ *   gains, skipping those whose gain has decreased because of points added before.
+ * - After each insertion, a local search removes Steiner points of degree at most two and moves Steiner points to the
+ *   median of their neighbors in the spanning tree as long as this decreases its cost
+ * The heuristics stop once the time budget is exhausted, in which case the best tree found so far is used. Prim-Steiner
+ * from the first terminal always runs, so the result is never worse than that of PrimSteinerHeuristic.
+ * All buffers are kept between calls, so computing bounds for many instances of similar size does not allocate.
+ */
+class HeuristicPortfolio {
+public:
+    static std::chrono::milliseconds constexpr default_time_budget{100};
+
+    explicit HeuristicPortfolio(std::chrono::steady_clock::duration time_budget = default_time_budget);
+
+    /// If thread_pool is not null, the Prim-Steiner runs and the 1-Steiner candidates are distributed over its threads
+    [[nodiscard]] Cost compute_upper_bound(std::vector<Point> const& terminals, ThreadPool* thread_pool);
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// Prim's algorithm on the complete graph of a point set with L1 distances. Keeps its memory between calls.
+    class SpanningTree {
+    public:
+        /// Computes a minimum spanning tree of the points and returns its cost
+        Cost compute(std::vector<Point> const& points);
+
+        /// The neighbor of each point on the path to the first point in the last computed tree
+        [[nodiscard]] std::vector<std::size_t> const& get_parents() const { return _parents; }
+    private:
+        std::vector<std::size_t> _parents;
+        std::vector<Cost> _distances;
+        std::vector<bool> _in_tree;
+    };
+
+    /// The buffers of one parallel task of find_improving_steiner_points
+    struct CandidateTask {
+        SpanningTree tree;
+        std::vector<Point> extended_points;
+    };
+
+    /// Number of 1-Steiner candidates evaluated by one parallel task
+    static std::size_t constexpr candidates_per_task = 64;
+
+    /// The minimum cost of the Prim-Steiner trees started at each terminal
+    [[nodiscard]] Cost run_prim_steiner(
+        std::vector<Point> const& terminals, ThreadPool* thread_pool, Clock::time_point deadline
+    );
+
+    [[nodiscard]] Cost run_iterated_one_steiner(
+        std::vector<Point> const& terminals, ThreadPool* thread_pool, Clock::time_point deadline
+    );
+
+    /// Fills _candidates with all points of the Hanan grid of the terminals
+    void compute_hanan_points(std::vector<Point> const& terminals);
+
+    /**
+     * Computes the cost of a minimum spanning tree of _points and each candidate
+     * @return all candidates which result in a spanning tree cheaper than current_cost with the cost of this tree, in
+     * increasing order of the cost. Ties are broken by the order of the candidates.
+     */
+    [[nodiscard]] std::vector<std::pair<Cost, Point>> const& find_improving_steiner_points(
+        Cost current_cost, ThreadPool* thread_pool, Clock::time_point deadline
+    );
+
+    /**
+     * Local search on the Steiner points, i.e. all points of _points after the first num_terminals
+     * @return the cost of a minimum spanning tree of the improved points
+     */
+    Cost improve_steiner_points(std::size_t num_terminals);
+
+    Clock::duration _time_budget;
+    /// One heuristic per start terminal, so that the parallel runs don't share memory
+    std::vector<PrimSteinerHeuristic> _prim_steiner_heuristics;
+    /// Indexed by start terminal for Prim-Steiner, by candidate for 1-Steiner
+    std::vector<Cost> _costs;
+    std::array<std::vector<Coord>, num_dimensions> _axes;
+    /// The points of the Hanan grid, which are the candidates for Steiner points
+    std::vector<Point> _candidates;
+    /// The terminals followed by the Steiner points of the current tree
+    std::vector<Point> _points;
+    SpanningTree _tree;
+    std::vector<CandidateTask> _candidate_tasks;
+    std::vector<std::pair<Cost, Point>> _improving_points;
+    /// The neighbors of each point in the spanning tree, only the first _points.size() entries are used
+    std::vector<std::vector<std::size_t>> _neighbors;
+    std::vector<Coord> _neighbor_coords;
+};
+
+#endif
@@ -4,56 +4,81 @@
 #include <iostream>
 #include "PrimSteinerHeuristic.h"
 
-PrimSteinerHeuristic::PrimSteinerHeuristic(HananGrid const& grid) :
-    _is_terminal_in_tree(grid.num_terminals()) {
-    for (auto const& terminal : grid.get_terminals()) {
-        _terminals.push_back(grid.to_coordinates(terminal.indices));
-    }
+PrimSteinerHeuristic::PrimSteinerHeuristic(std::vector<Point> const& terminals) {
+    reset(terminals);
+}
+
+void PrimSteinerHeuristic::reset(std::vector<Point> const& terminals) {
+    _terminals.assign(terminals.begin(), terminals.end());
 }
 
-Cost PrimSteinerHeuristic::compute_upper_bound() {
-    _is_terminal_in_tree.at(0) = true;
+Cost PrimSteinerHeuristic::compute_upper_bound(TerminalIndex const start_terminal) {
+    _is_terminal_in_tree.assign(_terminals.size(), false);
+    _tree_edges.clear();
+    _closest_edges.assign(_terminals.size(), ClosestEdge{});
+    _is_terminal_in_tree.at(start_terminal) = true;
     // Add zero-length edge to get rid of special case for first edge
-    _tree_edges.emplace_back(_terminals.at(0), _terminals.at(0));
+    _tree_edges.emplace_back(_terminals.at(start_terminal), _terminals.at(start_terminal));
+    update_closest_edges(0, std::nullopt);
     for (std::size_t i = 1; i < _terminals.size(); ++i) {
         auto const[next_terminal, edge_to_split] = get_closest_terminal_and_edge();
         add_terminal_to_tree(next_terminal, edge_to_split);
-        _is_terminal_in_tree.at(next_terminal) = true;
     }
     return std::accumulate(_tree_edges.begin(), _tree_edges.end(), 0, [](Cost a, GridEdge const& b) {
-        return a + HananGrid::get_distance(b.first, b.second);
+        return a + get_distance(b.first, b.second);
     });
 }
 
 std::pair<TerminalIndex, std::size_t> PrimSteinerHeuristic::get_closest_terminal_and_edge() const {
-    std::optional<std::pair<TerminalIndex, std::size_t>> best;
-    std::optional<Cost> best_cost;
+    std::optional<TerminalIndex> best;
     for (TerminalIndex next = 0; next < _terminals.size(); ++next) {
         if (_is_terminal_in_tree.at(next)) { continue; }
-        auto const& terminal = _terminals.at(next);
-        for (std::size_t edge_id = 0; edge_id < _tree_edges.size(); ++edge_id) {
-            auto const distance = distance_to_sp(terminal, _tree_edges.at(edge_id));
-            if (not best_cost or distance < *best_cost) {
-                best = std::make_pair(next, edge_id);
-                best_cost = distance;
+        if (not best or _closest_edges.at(next).distance < _closest_edges.at(*best).distance) {
+            best = next;
+        }
+    }
+    return {best.value(), _closest_edges.at(best.value()).edge_id};
+}
+
+void PrimSteinerHeuristic::update_closest_edges(
+    std::size_t const first_new_edge_id, std::optional<std::size_t> const shortened_edge_id
+) {
+    for (TerminalIndex terminal = 0; terminal < _terminals.size(); ++terminal) {
+        if (_is_terminal_in_tree.at(terminal)) { continue; }
+        auto& closest = _closest_edges.at(terminal);
+        // Shortening an edge can only increase the distance to it, so other edges may be closer now
+        auto first_edge_id = first_new_edge_id;
+        if (shortened_edge_id == closest.edge_id) {
+            closest = ClosestEdge{};
+            first_edge_id = 0;
+        }
+        for (auto edge_id = first_edge_id; edge_id < _tree_edges.size(); ++edge_id) {
+            auto const distance = distance_to_sp(_terminals.at(terminal), _tree_edges.at(edge_id));
+            if (distance < closest.distance) {
+                closest = {distance, edge_id};
             }
         }
     }
-    return best.value();
 }
 
 void PrimSteinerHeuristic::add_terminal_to_tree(TerminalIndex terminal_id, std::size_t edge_id) {
     auto& edge = _tree_edges.at(edge_id);
     auto const terminal_point = _terminals.at(terminal_id);
     auto const attached_point = get_closest_sp_point(terminal_point, edge);
+    auto const first_new_edge_id = _tree_edges.size();
+    std::optional<std::size_t> shortened_edge_id;
     // Split edge is required
     if (edge.first != attached_point and edge.second != attached_point) {
         auto const second = edge.second;
         edge.second = attached_point;
         _tree_edges.emplace_back(attached_point, second);
+        shortened_edge_id = edge_id;
     }
     // Do this after splitting the edge, otherwise the edge-reference may become invalid
     _tree_edges.emplace_back(terminal_point, attached_point);
+    // The terminal has to be marked first, so that it is skipped by the update
+    _is_terminal_in_tree.at(terminal_id) = true;
+    update_closest_edges(first_new_edge_id, shortened_edge_id);
 }
 
 Point PrimSteinerHeuristic::get_closest_sp_point(Point const& p, GridEdge const& edge) {
@@ -66,6 +91,6 @@ Point PrimSteinerHeuristic::get_closest_sp_point(Point const& p, GridEdge const&
 }
 
 Cost PrimSteinerHeuristic::distance_to_sp(Point const& p, GridEdge const& edge) {
-    return HananGrid::get_distance(p, get_closest_sp_point(p, edge));
+    return get_distance(p, get_closest_sp_point(p, edge));
 }
 
@@ -2,6 +2,7 @@
 #define PRIMSTEINERHEURISTIC_H
 
 #include "HananGrid.h"
+#include <optional>
 #include <utility>
 
 /**
@@ -10,16 +11,26 @@
  */
 class PrimSteinerHeuristic {
 public:
-    explicit PrimSteinerHeuristic(HananGrid const& grid);
+    explicit PrimSteinerHeuristic(std::vector<Point> const& terminals);
 
-    Cost compute_upper_bound();
+    /// Replaces the terminals, keeping the allocated memory
+    void reset(std::vector<Point> const& terminals);
+
+    /// Computes a Steiner tree by starting with the given terminal and returns its cost
+    Cost compute_upper_bound(TerminalIndex start_terminal = 0);
 
 private:
     using GridEdge = std::pair<Point, Point>;
 
+    /// The distance of a terminal to SP(edge) for the closest tree edge, and the smallest ID of such an edge
+    struct ClosestEdge {
+        Cost distance = invalid_cost;
+        std::size_t edge_id = 0;
+    };
+
     /**
      * Connected the terminal to the tree by a shortest path SP(edge_to_attach_to),
-     * splitting the edge as required
+     * splitting the edge as required, and marks it as contained in the tree
      */
     void add_terminal_to_tree(TerminalIndex index, std::size_t edge_attached_to);
 
@@ -29,6 +40,9 @@ private:
      */
     [[nodiscard]] std::pair<TerminalIndex, std::size_t> get_closest_terminal_and_edge() const;
 
+    /// Updates _closest_edges for the terminals not in the tree after the given edges have been added or shortened
+    void update_closest_edges(std::size_t first_new_edge_id, std::optional<std::size_t> shortened_edge_id);
+
     /**
      * Computes argmin{dist(p, v) | v \in SP(edge)}
      */
@@ -41,6 +55,8 @@ private:
 
     std::vector<bool> _is_terminal_in_tree;
     std::vector<GridEdge> _tree_edges;
+    /// For each terminal not in the tree the closest tree edge, maintained incrementally as edges are added
+    std::vector<ClosestEdge> _closest_edges;
     std::vector<Point> _terminals;
 };
 
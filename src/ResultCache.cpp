@@ -0,0 +1,241 @@
+#include "ResultCache.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::ostream& write_point(std::ostream& out, Point const& point) {
+    for (auto const coord : point) {
+        out << ' ' << coord;
+    }
+    return out;
+}
+
+bool read_point(std::istream& in, Point& point) {
+    for (auto& coord : point) {
+        in >> coord;
+    }
+    return static_cast<bool>(in);
+}
+
+}
+
+CanonicalInstance::CanonicalInstance(std::vector<Point> const& terminals) {
+    if (terminals.empty()) {
+        return;
+    }
+    _min = _max = terminals.front();
+    for (auto const& terminal : terminals) {
+        for (std::size_t axis = 0; axis < num_dimensions; ++axis) {
+            _min.at(axis) = std::min(_min.at(axis), terminal.at(axis));
+            _max.at(axis) = std::max(_max.at(axis), terminal.at(axis));
+        }
+    }
+    std::array<std::size_t, num_dimensions> axes{};
+    std::iota(axes.begin(), axes.end(), 0);
+    auto best_axes = axes;
+    auto best_reflected = _reflected;
+    std::vector<Point> candidate(terminals.size());
+    do {
+        for (unsigned reflections = 0; reflections < (1u << num_dimensions); ++reflections) {
+            _axes = axes;
+            for (std::size_t axis = 0; axis < num_dimensions; ++axis) {
+                _reflected.at(axis) = ((reflections >> axis) & 1u) != 0;
+            }
+            std::transform(
+                terminals.begin(), terminals.end(), candidate.begin(), [&](Point const& terminal) {
+                    return to_canonical(terminal);
+                }
+            );
+            std::sort(candidate.begin(), candidate.end());
+            if (_terminals.empty() or candidate < _terminals) {
+                _terminals = candidate;
+                best_axes = _axes;
+                best_reflected = _reflected;
+            }
+        }
+    } while (std::next_permutation(axes.begin(), axes.end()));
+    _axes = best_axes;
+    _reflected = best_reflected;
+}
+
+Point CanonicalInstance::to_canonical(Point const& point) const {
+    Point result;
+    for (std::size_t axis = 0; axis < num_dimensions; ++axis) {
+        auto const original_axis = _axes.at(axis);
+        auto const coord = point.at(original_axis);
+        result.at(axis) = _reflected.at(axis) ? _max.at(original_axis) - coord : coord - _min.at(original_axis);
+    }
+    return result;
+}
+
+Point CanonicalInstance::from_canonical(Point const& point) const {
+    Point result;
+    for (std::size_t axis = 0; axis < num_dimensions; ++axis) {
+        auto const original_axis = _axes.at(axis);
+        auto const coord = point.at(axis);
+        auto const max = _max.at(original_axis);
+        result.at(original_axis) = _reflected.at(axis) ? max - coord : coord + _min.at(original_axis);
+    }
+    return result;
+}
+
+ResultCache::ResultCache(std::size_t const capacity) : _capacity(capacity) {}
+
+std::optional<ResultCache::Result> ResultCache::lookup(std::vector<Point> const& terminals) {
+    CanonicalInstance const canonical(terminals);
+    std::optional<Result> result;
+    {
+        std::scoped_lock const lock(_mutex);
+        ++_num_lookups;
+        auto const found = _index.find(canonical.get_terminals());
+        if (found == _index.end()) {
+            return std::nullopt;
+        }
+        ++_num_hits;
+        _entries.splice(_entries.begin(), _entries, found->second);
+        result = found->second->result;
+    }
+    if (result->tree_edges.has_value()) {
+        for (auto& [from, to] : result->tree_edges.value()) {
+            from = canonical.from_canonical(from);
+            to = canonical.from_canonical(to);
+        }
+    }
+    return result;
+}
+
+void ResultCache::insert(std::vector<Point> const& terminals, Result const& result) {
+    CanonicalInstance const canonical(terminals);
+    Entry entry{canonical.get_terminals(), result};
+    if (entry.result.tree_edges.has_value()) {
+        // Tree vertices lie in the Hanan grid, so within the bounding box of the terminals
+        for (auto& [from, to] : entry.result.tree_edges.value()) {
+            from = canonical.to_canonical(from);
+            to = canonical.to_canonical(to);
+        }
+    }
+    std::scoped_lock const lock(_mutex);
+    insert_canonical(std::move(entry));
+}
+
+void ResultCache::insert_canonical(Entry entry) {
+    if (_capacity == 0) {
+        return;
+    }
+    auto const existing = _index.find(entry.terminals);
+    if (existing != _index.end()) {
+        if (not entry.result.tree_edges.has_value()) {
+            entry.result.tree_edges = std::move(existing->second->result.tree_edges);
+        }
+        _entries.erase(existing->second);
+        _index.erase(existing);
+    }
+    _entries.push_front(std::move(entry));
+    _index.emplace(_entries.front().terminals, _entries.begin());
+    if (_entries.size() > _capacity) {
+        _index.erase(_entries.back().terminals);
+        _entries.pop_back();
+    }
+}
+
+bool ResultCache::load(std::filesystem::path const& path) {
+    std::ifstream in(path);
+    if (not in) {
+        std::cerr << "Failed to open " << path << '\n';
+        return false;
+    }
+    std::scoped_lock const lock(_mutex);
+    std::string line;
+    std::size_t line_number = 0;
+    // Each line is "<n> <n terminals> <cost> -" or "<n> <n terminals> <cost> <m> <m edges>", see save
+    while (std::getline(in, line)) {
+        ++line_number;
+        std::istringstream line_stream(line);
+        std::size_t num_terminals = 0;
+        Entry entry;
+        bool valid = static_cast<bool>(line_stream >> num_terminals) and num_terminals <= max_num_terminals;
+        entry.terminals.resize(valid ? num_terminals : 0);
+        for (auto& terminal : entry.terminals) {
+            valid = valid and read_point(line_stream, terminal);
+        }
+        std::string tree_size;
+        valid = valid and line_stream >> entry.result.cost >> tree_size;
+        if (valid and tree_size != "-") {
+            std::size_t num_edges = 0;
+            auto const tree_size_end = tree_size.data() + tree_size.size();
+            auto const[end, parse_error] = std::from_chars(tree_size.data(), tree_size_end, num_edges);
+            // A tree has fewer edges than the Hanan grid has vertices
+            valid = parse_error == std::errc{} and end == tree_size_end and
+                num_edges < get_max_num_vertices(max_num_terminals);
+            auto& edges = entry.result.tree_edges.emplace();
+            edges.resize(valid ? num_edges : 0);
+            for (auto& [from, to] : edges) {
+                valid = valid and read_point(line_stream, from) and read_point(line_stream, to);
+            }
+        }
+        if (not valid) {
+            std::cerr << "Malformed entry in line " << line_number << " of " << path << '\n';
+            return false;
+        }
+        insert_canonical(std::move(entry));
+    }
+    return true;
+}
+
+bool ResultCache::save(std::filesystem::path const& path) const {
+    auto temporary_path = path;
+    temporary_path += ".tmp";
+    std::ofstream out(temporary_path);
+    {
+        std::scoped_lock const lock(_mutex);
+        // The least recently used entry first, so that load restores the order
+        for (auto entry = _entries.rbegin(); entry != _entries.rend(); ++entry) {
+            out << entry->terminals.size();
+            for (auto const& terminal : entry->terminals) {
+                write_point(out, terminal);
+            }
+            out << ' ' << entry->result.cost << ' ';
+            if (entry->result.tree_edges.has_value()) {
+                out << entry->result.tree_edges->size();
+                for (auto const& [from, to] : entry->result.tree_edges.value()) {
+                    write_point(write_point(out, from), to);
+                }
+            } else {
+                out << '-';
+            }
+            out << '\n';
+        }
+    }
+    out.close();
+    std::error_code error;
+    if (out) {
+        std::filesystem::rename(temporary_path, path, error);
+    }
+    if (not out or error) {
+        std::cerr << "Failed to write " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+ResultCache::Stats ResultCache::get_stats() const {
+    std::scoped_lock const lock(_mutex);
+    return {_num_lookups, _num_hits, _entries.size()};
+}
+
+std::size_t ResultCache::TerminalsHash::operator()(std::vector<Point> const& terminals) const {
+    auto result = terminals.size();
+    for (auto const& terminal : terminals) {
+        for (auto const coord : terminal) {
+            result ^= std::hash<Coord>{}(coord) + 0x9e3779b97f4a7c15ull + (result << 6) + (result >> 2);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,112 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "TypeDefs.h"
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * The terminals of an instance in a canonical form: Each of the 48 combinations of permuting and reflecting the axes
+ * is applied to the terminals, which are then translated so that their bounding box starts at the origin, and sorted.
+ * The canonical form is the lexicographically smallest of these lists. All of these maps preserve L1 distances and
+ * map the Hanan grid onto the Hanan grid of the image, so instances with the same canonical form have the same optimum
+ * cost, and their optimum trees are mapped onto each other.
+ */
+class CanonicalInstance {
+public:
+    explicit CanonicalInstance(std::vector<Point> const& terminals);
+
+    [[nodiscard]] std::vector<Point> const& get_terminals() const { return _terminals; }
+
+    /// Maps a point within the bounding box of the original terminals to canonical coordinates
+    [[nodiscard]] Point to_canonical(Point const& point) const;
+
+    /// The inverse of to_canonical
+    [[nodiscard]] Point from_canonical(Point const& point) const;
+private:
+    /// Canonical axis i is original axis _axes[i], reversed if _reflected[i]
+    std::array<std::size_t, num_dimensions> _axes{};
+    std::array<bool, num_dimensions> _reflected{};
+    /// The bounding box of the original terminals
+    Point _min{};
+    Point _max{};
+    std::vector<Point> _terminals;
+};
+
+/**
+ * Optimum costs, and optimum trees if available, of previously solved instances. Entries are keyed by the
+ * CanonicalInstance of the terminals, so translated, reflected or permuted copies of an instance share an entry. The
+ * cache holds at most capacity entries and evicts the least recently used one. It can be saved to a text file and
+ * loaded again by a later run. All methods may be called concurrently.
+ */
+class ResultCache {
+public:
+    using Edge = std::pair<Point, Point>;
+
+    struct Result {
+        Cost cost = invalid_cost;
+        /// The edges of an optimum tree, std::nullopt if it was not stored
+        std::optional<std::vector<Edge>> tree_edges{};
+    };
+
+    struct Stats {
+        std::size_t num_lookups = 0;
+        std::size_t num_hits = 0;
+        std::size_t num_entries = 0;
+
+        [[nodiscard]] double hit_rate() const {
+            return num_lookups == 0 ? 0. : static_cast<double>(num_hits) / static_cast<double>(num_lookups);
+        }
+    };
+
+    static std::size_t constexpr default_capacity = std::size_t{1} << 16;
+
+    explicit ResultCache(std::size_t capacity = default_capacity);
+
+    /// The stored result for the instance with the given terminals, with the tree in their coordinates
+    [[nodiscard]] std::optional<Result> lookup(std::vector<Point> const& terminals);
+
+    /// Stores the optimum of an instance. A stored tree is kept if the new result has none.
+    void insert(std::vector<Point> const& terminals, Result const& result);
+
+    /**
+     * Adds the entries of a file written by save, in their original order of use. Prints an error and returns false
+     * if the file can't be read or is malformed, in which case the entries before the error are kept.
+     */
+    bool load(std::filesystem::path const& path);
+
+    /// Writes all entries to a file, replacing it once all are written. Returns false on failure.
+    [[nodiscard]] bool save(std::filesystem::path const& path) const;
+
+    [[nodiscard]] Stats get_stats() const;
+private:
+    struct Entry {
+        /// The canonical terminals, and the tree in canonical coordinates
+        std::vector<Point> terminals;
+        Result result;
+    };
+
+    struct TerminalsHash {
+        std::size_t operator()(std::vector<Point> const& terminals) const;
+    };
+
+    /// Inserts an entry in canonical coordinates as the most recently used, must be called with _mutex locked
+    void insert_canonical(Entry entry);
+
+    std::size_t _capacity;
+    std::mutex mutable _mutex;
+    /// The most recently used entry first
+    std::list<Entry> _entries;
+    std::unordered_map<std::vector<Point>, std::list<Entry>::iterator, TerminalsHash> _index;
+    std::size_t _num_lookups = 0;
+    std::size_t _num_hits = 0;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+
+/// Set by the CMake option DIJKSTRASTEINER_STATS
+#ifdef DIJKSTRASTEINER_STATS
+bool constexpr stats_enabled = true;
+#else
+bool constexpr stats_enabled = false;
+#endif
+
+enum class Counter {
+    labels_pushed,
+    labels_popped,
+    /// Popped labels which had already been fixed through an earlier heap entry
+    stale_labels_popped,
+    labels_fixed,
+    /// Popped labels whose cost exceeds the Lemma 15 bound of their subset, and are not expanded
+    fixed_labels_pruned_by_lemma_15,
+    candidates_pruned_by_upper_bound,
+    candidates_pruned_by_lemma_15,
+    /// Candidates for labels which are already fixed
+    candidates_pruned_by_fixed,
+    /// Candidates which do not improve the current cost of a label that is not fixed
+    candidates_pruned_by_cost,
+    /// Candidates improving the cost of their label, which exceed the upper bound with the future cost added
+    candidates_pruned_by_future_cost,
+    indexer_cache_hits,
+    indexer_cache_misses,
+    /// Completions of fixed labels which lowered the upper bound
+    upper_bound_improvements,
+    num_counters
+};
+
+enum class Phase {
+    init,
+    future_cost,
+    neighbor_expansion,
+    merge_expansion,
+    parallel_candidate_collection,
+    parallel_candidate_reduction,
+    num_phases
+};
+
+/**
+ * Counters and timers collected during the search. Only the specialization for Enabled = true records anything; the
+ * other one is empty and all its methods are no-ops, so instrumented code compiles to the uninstrumented code if
+ * DIJKSTRASTEINER_STATS is not defined. Use the alias SearchStats.
+ * Phases may be nested (e.g. future_cost is part of the expansion phases), each timer measures the total wall time
+ * spent in its phase.
+ */
+template<bool Enabled>
+class BasicSearchStats;
+
+template<>
+class BasicSearchStats<true> {
+public:
+    /// Adds the time between its construction and destruction to a phase
+    class ScopedTimer {
+    public:
+        ScopedTimer(BasicSearchStats& stats, Phase const phase) :
+            _stats(stats), _phase(phase), _start(std::chrono::steady_clock::now()) {}
+
+        ~ScopedTimer() {
+            _stats._phase_times.at(static_cast<std::size_t>(_phase)) += std::chrono::steady_clock::now() - _start;
+        }
+
+        ScopedTimer(ScopedTimer const&) = delete;
+
+        ScopedTimer& operator=(ScopedTimer const&) = delete;
+    private:
+        BasicSearchStats& _stats;
+        Phase _phase;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    void count(Counter const counter, std::uint64_t const amount = 1) {
+        _counters[static_cast<std::size_t>(counter)] += amount;
+    }
+
+    void update_max_heap_size(std::size_t const heap_size) {
+        _max_heap_size = std::max<std::uint64_t>(_max_heap_size, heap_size);
+    }
+
+    [[nodiscard]] ScopedTimer time(Phase const phase) { return ScopedTimer{*this, phase}; }
+
+    [[nodiscard]] std::uint64_t get(Counter const counter) const {
+        return _counters.at(static_cast<std::size_t>(counter));
+    }
+
+    /// Adds all counters and times of other to this, and takes the maximum of the heap sizes
+    void merge(BasicSearchStats const& other);
+
+    void reset() { *this = BasicSearchStats{}; }
+
+    /// Writes all statistics as a single JSON object
+    void write_json(std::ostream& out) const;
+private:
+    static std::size_t constexpr num_counters = static_cast<std::size_t>(Counter::num_counters);
+    static std::size_t constexpr num_phases = static_cast<std::size_t>(Phase::num_phases);
+
+    static std::array<char const*, num_counters> constexpr counter_names{
+        "labels_pushed", "labels_popped", "stale_labels_popped", "labels_fixed", "fixed_labels_pruned_by_lemma_15",
+        "candidates_pruned_by_upper_bound", "candidates_pruned_by_lemma_15", "candidates_pruned_by_fixed",
+        "candidates_pruned_by_cost", "candidates_pruned_by_future_cost", "indexer_cache_hits", "indexer_cache_misses",
+        "upper_bound_improvements"
+    };
+    static std::array<char const*, num_phases> constexpr phase_names{
+        "init", "future_cost", "neighbor_expansion", "merge_expansion", "parallel_candidate_collection",
+        "parallel_candidate_reduction"
+    };
+
+    std::array<std::uint64_t, num_counters> _counters{};
+    std::uint64_t _max_heap_size = 0;
+    std::array<std::chrono::steady_clock::duration, num_phases> _phase_times{};
+};
+
+template<>
+class BasicSearchStats<false> {
+public:
+    class ScopedTimer {
+    public:
+        // User-provided, so that unused timers do not cause warnings
+        ~ScopedTimer() {}
+    };
+
+    void count(Counter, std::uint64_t = 1) {}
+
+    void update_max_heap_size(std::size_t) {}
+
+    [[nodiscard]] ScopedTimer time(Phase) { return {}; }
+
+    [[nodiscard]] std::uint64_t get(Counter) const { return 0; }
+
+    void merge(BasicSearchStats const&) {}
+
+    void reset() {}
+
+    void write_json(std::ostream& out) const { out << "{}"; }
+};
+
+using SearchStats = BasicSearchStats<stats_enabled>;
+
+inline void BasicSearchStats<true>::merge(BasicSearchStats const& other) {
+    for (std::size_t i = 0; i < num_counters; ++i) {
+        _counters[i] += other._counters[i];
+    }
+    for (std::size_t i = 0; i < num_phases; ++i) {
+        _phase_times[i] += other._phase_times[i];
+    }
+    _max_heap_size = std::max(_max_heap_size, other._max_heap_size);
+}
+
+inline void BasicSearchStats<true>::write_json(std::ostream& out) const {
+    out << "{\"counters\": {";
+    for (std::size_t i = 0; i < num_counters; ++i) {
+        out << (i == 0 ? "" : ", ") << '"' << counter_names[i] << "\": " << _counters[i];
+    }
+    out << "}, \"max_heap_size\": " << _max_heap_size;
+    auto const num_indexer_queries = get(Counter::indexer_cache_hits) + get(Counter::indexer_cache_misses);
+    out << ", \"indexer_cache_hit_rate\": "
+        << (num_indexer_queries == 0 ? 1.0 :
+            static_cast<double>(get(Counter::indexer_cache_hits)) / static_cast<double>(num_indexer_queries));
+    out << ", \"phase_seconds\": {";
+    for (std::size_t i = 0; i < num_phases; ++i) {
+        out << (i == 0 ? "" : ", ") << '"' << phase_names[i]
+            << "\": " << std::chrono::duration<double>(_phase_times[i]).count();
+    }
+    out << "}}";
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SOLVER_INSTANCES_H
+#define SOLVER_INSTANCES_H
+
+#include "DijkstraSteiner.h"
+#include "future_costs/FutureCostSelection.h"
+#include "queues/RadixHeapQueue.h"
+
+/// The solver for instances with at most MaxTerminals terminals and the given future cost
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC>
+using Solver = DijkstraSteiner<MaxTerminals, FC, RadixHeapQueue>;
+
+/**
+ * Declares (with PREFIX extern) or defines (with an empty PREFIX) the explicit instantiations of Solver for each of
+ * the terminal_widths and the future cost template FC.
+ * Each of the SelectableFutureCosts is instantiated in its own translation unit in solver_instances/. Apart from
+ * compiling in parallel, this keeps the inlining decisions for one solver independent of the others: Helpers shared
+ * by all solvers of a width are no longer inlined into the search loop once several solvers are instantiated in the
+ * same translation unit.
+ */
+#define SOLVER_INSTANCES(PREFIX, FC) \
+    PREFIX template class DijkstraSteiner<4, FC<4>, RadixHeapQueue>; \
+    PREFIX template class DijkstraSteiner<8, FC<8>, RadixHeapQueue>; \
+    PREFIX template class DijkstraSteiner<12, FC<12>, RadixHeapQueue>; \
+    PREFIX template class DijkstraSteiner<16, FC<16>, RadixHeapQueue>; \
+    PREFIX template class DijkstraSteiner<20, FC<20>, RadixHeapQueue>; \
+    PREFIX template class DijkstraSteiner<32, FC<32>, RadixHeapQueue>; \
+    PREFIX template class DijkstraSteiner<64, FC<64>, RadixHeapQueue>;
+
+static_assert(terminal_widths == std::array<TerminalIndex, 7>{4, 8, 12, 16, 20, 32, 64});
+
+SOLVER_INSTANCES(extern, NullFutureCost)
+SOLVER_INSTANCES(extern, BBFutureCost)
+SOLVER_INSTANCES(extern, OneTreeFutureCost)
+SOLVER_INSTANCES(extern, OneTreeBBFutureCost)
+
+#endif
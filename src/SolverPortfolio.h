@@ -0,0 +1,133 @@
+#ifndef SOLVER_PORTFOLIO_H
+#define SOLVER_PORTFOLIO_H
+
+#include "SolverInstances.h"
+#include "HeuristicPortfolio.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/// A configuration of the solver raced by solve_with_portfolio
+struct SolverConfiguration {
+    FutureCostKind future_cost = FutureCostKind::max;
+    /// Index of the root terminal in the input, i.e. the terminal whose label ends the search
+    std::size_t root_terminal = 0;
+};
+
+struct PortfolioResult {
+    /// The best bounds of all configurations, both equal to the optimum cost if one configuration finished
+    CostBounds bounds;
+    /// The index of the configuration which found the optimum first, std::nullopt if all stopped at a limit
+    std::optional<std::size_t> winner;
+    /// The tree found by the winner, empty unless reconstruct_tree was set in the options
+    std::vector<std::pair<Point, Point>> tree_edges;
+};
+
+/**
+ * The first num_configurations configurations of the portfolio: Configuration i uses the (n - 1 - i mod n)-th of the
+ * n terminals as root, so configuration 0 is the solver run without a portfolio, and the future costs max, bb and
+ * one-tree in turn. The null future cost is never chosen, since it is much slower than the others on our instances.
+ * Without terminals, all configurations use root 0.
+ */
+[[nodiscard]] inline std::vector<SolverConfiguration> get_portfolio_configurations(
+    std::size_t const num_terminals, std::size_t const num_configurations
+) {
+    std::array<FutureCostKind, 3> constexpr future_costs{
+        FutureCostKind::max, FutureCostKind::bb, FutureCostKind::one_tree
+    };
+    std::vector<SolverConfiguration> result;
+    for (std::size_t configuration = 0; configuration < num_configurations; ++configuration) {
+        auto const future_cost = future_costs.at(configuration % future_costs.size());
+        auto const root_terminal = num_terminals == 0 ? 0 : num_terminals - 1 - configuration % num_terminals;
+        result.push_back({future_cost, root_terminal});
+    }
+    return result;
+}
+
+/**
+ * Races the given configurations of the solver on one instance, each in its own thread. The initial upper bound is
+ * computed once with all threads and passed to the solvers in the shared state, so they skip their own heuristics.
+ * They share all upper bounds they find afterwards. As soon as one of them
+ * has found the optimum, the others are stopped. Limits and the time budget of the initial upper bound are taken
+ * from the options, and only the first configuration reports progress. The number of threads in the options is
+ * ignored, each configuration runs single-threaded.
+ */
+template<TerminalIndex MaxTerminals>
+PortfolioResult solve_with_portfolio(
+    std::vector<Point> const& terminals, std::vector<SolverConfiguration> const& configurations,
+    SolverOptions options
+) {
+    ThreadPool thread_pool(configurations.size());
+    SharedSearchState shared_state;
+    shared_state.upper_bound = HeuristicPortfolio(options.upper_bound_time_budget).compute_upper_bound(
+        terminals, &thread_pool
+    );
+    options.num_threads = 1;
+    options.shared_state = &shared_state;
+
+    std::vector<CostBounds> bounds(configurations.size(), CostBounds{0, invalid_cost});
+    PortfolioResult result;
+    // Exceptions must not escape the threads of the pool, the first one is rethrown if no configuration finished
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    thread_pool.parallel_for(
+        configurations.size(), [&](std::size_t const index) {
+            try {
+                auto const& configuration = configurations.at(index);
+                // Moving the root to the end keeps the order of the other terminals up to rotation
+                auto configured_terminals = terminals;
+                if (not configured_terminals.empty()) {
+                    auto const root = configured_terminals.begin()
+                        + static_cast<std::ptrdiff_t>(configuration.root_terminal);
+                    std::rotate(configured_terminals.begin(), root + 1, configured_terminals.end());
+                }
+                auto configured_options = options;
+                if (index > 0) {
+                    configured_options.progress_interval.reset();
+                }
+                dispatch_future_cost<MaxTerminals>(
+                    configuration.future_cost, [&]<FutureCost<MaxTerminals> FC>() {
+                        Solver<MaxTerminals, FC> solver(
+                            HananGrid<MaxTerminals>(configured_terminals), configured_options
+                        );
+                        bounds.at(index) = solver.solve();
+                        // Only the first solver to finish sets the flag, which also stops all others
+                        if (solver.found_optimum() and not shared_state.stop.exchange(true)) {
+                            result.winner = index;
+                            if (options.reconstruct_tree) {
+                                result.tree_edges = solver.get_tree_edges();
+                            }
+                        }
+                    }
+                );
+            } catch (...) {
+                std::scoped_lock const lock(error_mutex);
+                if (error == nullptr) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    );
+
+    if (error != nullptr and not result.winner.has_value()) {
+        std::rethrow_exception(error);
+    }
+    if (result.winner.has_value()) {
+        result.bounds = bounds.at(result.winner.value());
+    } else {
+        // All bounds are valid for the same instance, so the best of each can be combined
+        result.bounds = CostBounds{0, shared_state.upper_bound.load()};
+        for (auto const& configuration_bounds : bounds) {
+            result.bounds.lower_bound = std::max(result.bounds.lower_bound, configuration_bounds.lower_bound);
+        }
+        result.bounds.lower_bound = std::min(result.bounds.lower_bound, result.bounds.upper_bound);
+    }
+    return result;
+}
+
+#endif
@@ -4,72 +4,165 @@
 #include <unordered_map>
 #include <optional>
 #include <cassert>
+#include <bit>
+#include <algorithm>
 #include "TypeDefs.h"
 #include "HananGrid.h"
+#include "SearchStats.h"
 
 
 /**
- * Lazily assigns unique indices to subsets of the terminal set. The last queried subset is cached, so repeated queries
+ * Assigns unique indices to subsets of the first num_indexed_terminals terminals. If an index table with one entry per
+ * subset fits into the memory budget given on construction, the indexer is "dense": The index of a subset is the
+ * bitmask of the subset itself, and no hashing is involved.
+ * Otherwise indices are assigned lazily through a hash map. The last queried subset is cached, so repeated queries
  * for the same subset are fast. On all methods allow_mismatch indicates whether this call is expected to (sometimes)
  * require a new index to be retrieved from the underlying hash map, or whether the call is expected to always hit the
- * cache.
+ * cache. In dense mode allow_mismatch is ignored.
  */
+template<TerminalIndex MaxTerminals>
 class SubsetIndexer {
 public:
+    /// Rough upper bound on the memory used per subset by all Subset- and LabelMaps of one solver in dense mode
+    static std::size_t constexpr estimated_bytes_per_dense_subset = 128;
+    static std::size_t constexpr default_dense_budget = std::size_t{256} << 20;
+
+    /**
+     * @param num_indexed_terminals only subsets of the terminals with indices less than this will be queried
+     * @param dense_budget number of bytes the dense mode may use, see estimated_bytes_per_dense_subset
+     */
+    explicit SubsetIndexer(TerminalIndex num_indexed_terminals, std::size_t dense_budget = default_dense_budget);
+
+    /**
+     * Forgets all assigned indices and prepares the indexer for subsets of the given number of terminals. Subset- and
+     * LabelMaps using this indexer have to be reset afterwards.
+     */
+    void reset(TerminalIndex num_indexed_terminals);
+
+    [[nodiscard]] bool is_dense() const { return _num_dense_indices > 0; }
+
+    /// The number of indices in dense mode (i.e. all indices are less than this), 0 if the indexer is not dense
+    [[nodiscard]] std::size_t num_dense_indices() const { return _num_dense_indices; }
+
     /// Get the index if it has been assigned, or std::nullopt otherwise
-    std::optional<std::size_t> get_index_for(TerminalSubset const& subset, bool allow_mismatch) const;
+    std::optional<std::size_t> get_index_for(TerminalSubset<MaxTerminals> const& subset, bool allow_mismatch) const;
 
     /// Get the index for the given subset, assigning a new index if none has been assigned yet
-    std::size_t get_index_or_insert(TerminalSubset const& subset, bool allow_mismatch);
+    std::size_t get_index_or_insert(TerminalSubset<MaxTerminals> const& subset, bool allow_mismatch);
+
+    /// Hits and misses of the last query cache since the last reset. Not counted in dense mode.
+    [[nodiscard]] SearchStats const& get_stats() const { return _stats; }
 private:
-    TerminalSubset mutable _last_query{-1ul};
+    std::size_t _dense_budget;
+    std::size_t _num_dense_indices = 0;
+    TerminalSubset<MaxTerminals> mutable _last_query{-1ul};
     std::optional<std::size_t> mutable _last_result;
-    std::unordered_map<TerminalSubset, std::size_t> _indices;
+    std::unordered_map<TerminalSubset<MaxTerminals>, std::size_t> _indices;
+    SearchStats mutable _stats;
 };
 
 /// Lazily maps subsets to values of the specified type.
-template<class T>
+template<TerminalIndex MaxTerminals, class T>
 class SubsetMap {
 public:
-    SubsetMap(SubsetIndexer& indexer, T initial = T{}): _indexer(indexer), _initial_value(initial) {}
+    SubsetMap(SubsetIndexer<MaxTerminals>& indexer, T initial = T{}): _indexer(indexer), _initial_value(initial) {
+        _storage.resize(_indexer.num_dense_indices(), _initial_value);
+    }
+
+    T& get_or_insert(TerminalSubset<MaxTerminals> const& subset, bool allow_mismatch = false);
 
-    T& get_or_insert(TerminalSubset const& subset, bool allow_mismatch = false);
+    T const& get_or_default(TerminalSubset<MaxTerminals> const& subset, bool allow_mismatch = false) const;
 
-    T const& get_or_default(TerminalSubset const& subset, bool allow_mismatch = false) const;
+    /// Resets all values to the initial value, keeping the allocated memory. Call after resetting the indexer.
+    void reset();
 private:
-    SubsetIndexer& _indexer;
+    SubsetIndexer<MaxTerminals>& _indexer;
     std::vector<T> mutable _storage;
+    /// All entries at this index and above have the initial value
+    std::size_t _num_used = 0;
     T _initial_value;
 };
 
 /**
- * Lazily maps Labels (i.e. terminal subsets with an additional vertex) to values of the specified type. This is
- * implemented as a SubsetMap to vectors of T, which is a slight waste of memory but also fast.
+ * Lazily maps Labels (i.e. terminal subsets with an additional vertex) to values of the specified type. The vertices
+ * are split into pages of page_size consecutive vertex indices; the values for a page of a given subset are only
+ * allocated once a label on this page is inserted. For each subset touched so far a table storing the offsets of its
+ * pages in a shared pool is kept.
+ * A page size of at least the number of vertices results in one vector of values per subset, which is fast but wastes
+ * memory if only few vertices are reached for most subsets.
  */
-template<class T>
+template<TerminalIndex MaxTerminals, class T>
 class LabelMap {
 public:
-    LabelMap(HananGrid const& grid, SubsetIndexer& indexer, T initial):
-        _storage(indexer, std::vector<T>(grid.num_vertices(), initial)) {}
+    using VertexIndex = ::VertexIndex<MaxTerminals>;
 
+    static VertexIndex constexpr default_page_size = 64;
 
-    typename std::vector<T>::reference get_or_insert(Label const& label, bool allow_mismatch = false) {
-        return _storage.get_or_insert(label.second, allow_mismatch).at(label.first.global_index);
-    }
+    /// page_size is rounded up to the next power of two
+    LabelMap(
+        HananGrid<MaxTerminals> const& grid, SubsetIndexer<MaxTerminals>& indexer, T initial,
+        VertexIndex page_size = default_page_size
+    );
+
+    typename std::vector<T>::reference get_or_insert(Label<MaxTerminals> const& label, bool allow_mismatch = false);
 
     typename std::vector<T>::const_reference get_or_default(
-            Label const& label, bool allow_mismatch = false
-    ) const {
-        return _storage.get_or_default(label.second, allow_mismatch).at(label.first.global_index);
-    }
+        Label<MaxTerminals> const& label, bool allow_mismatch = false
+    ) const;
+
+    /**
+     * The number of bytes of pages and page tables in use since the last reset. Memory that is retained from earlier
+     * instances but not used for the current one is not counted.
+     */
+    [[nodiscard]] std::size_t used_bytes() const;
+
+    /// Removes all values, keeping the allocated memory. Call after resetting the indexer.
+    void reset(HananGrid<MaxTerminals> const& grid);
 private:
-    SubsetMap<std::vector<T>> _storage;
+    using PageOffset = std::size_t;
+    static PageOffset constexpr no_page = std::numeric_limits<PageOffset>::max();
+
+    SubsetMap<MaxTerminals, std::vector<PageOffset>> _page_tables;
+    std::vector<T> _pages;
+    std::size_t _num_page_tables = 0;
+    VertexIndex _num_vertices;
+    unsigned _page_shift;
+    VertexIndex _page_mask;
+    T _initial_value;
 };
 
-inline std::optional<std::size_t> SubsetIndexer::get_index_for(
-    TerminalSubset const& subset, [[maybe_unused]] bool allow_mismatch
+template<TerminalIndex MaxTerminals>
+SubsetIndexer<MaxTerminals>::SubsetIndexer(
+    TerminalIndex const num_indexed_terminals, std::size_t const dense_budget
+) :
+    _dense_budget(dense_budget) {
+    reset(num_indexed_terminals);
+}
+
+template<TerminalIndex MaxTerminals>
+void SubsetIndexer<MaxTerminals>::reset(TerminalIndex const num_indexed_terminals) {
+    auto const num_subsets = std::size_t{1} << num_indexed_terminals;
+    if (num_subsets <= _dense_budget / estimated_bytes_per_dense_subset) {
+        _num_dense_indices = num_subsets;
+    } else {
+        _num_dense_indices = 0;
+    }
+    _last_query = TerminalSubset<MaxTerminals>{-1ul};
+    _last_result = std::nullopt;
+    _indices.clear();
+    _stats.reset();
+}
+
+template<TerminalIndex MaxTerminals>
+std::optional<std::size_t> SubsetIndexer<MaxTerminals>::get_index_for(
+    TerminalSubset<MaxTerminals> const& subset, [[maybe_unused]] bool allow_mismatch
 ) const {
+    if (is_dense()) {
+        assert(subset.to_ulong() < _num_dense_indices);
+        return subset.to_ulong();
+    }
     if (subset != _last_query) {
+        _stats.count(Counter::indexer_cache_misses);
         assert(allow_mismatch);
         auto const result_it = _indices.find(subset);
         _last_query = subset;
@@ -78,33 +171,56 @@ inline std::optional<std::size_t> SubsetIndexer::get_index_for(
         } else {
             _last_result = result_it->second;
         }
+    } else {
+        _stats.count(Counter::indexer_cache_hits);
     }
     return _last_result;
 }
 
-inline std::size_t SubsetIndexer::get_index_or_insert(
-    TerminalSubset const& subset, [[maybe_unused]] bool allow_mismatch
+template<TerminalIndex MaxTerminals>
+std::size_t SubsetIndexer<MaxTerminals>::get_index_or_insert(
+    TerminalSubset<MaxTerminals> const& subset, [[maybe_unused]] bool allow_mismatch
 ) {
+    if (is_dense()) {
+        assert(subset.to_ulong() < _num_dense_indices);
+        return subset.to_ulong();
+    }
     if (subset != _last_query or not _last_result.has_value()) {
+        _stats.count(Counter::indexer_cache_misses);
         assert(allow_mismatch or subset == _last_query);
         auto const result_it = _indices.emplace(subset, _indices.size()).first;
         _last_query = subset;
         _last_result = result_it->second;
+    } else {
+        _stats.count(Counter::indexer_cache_hits);
     }
     return _last_result.value();
 }
 
-template<class T>
-T& SubsetMap<T>::get_or_insert(TerminalSubset const& subset, bool allow_mismatch) {
+template<TerminalIndex MaxTerminals, class T>
+T& SubsetMap<MaxTerminals, T>::get_or_insert(TerminalSubset<MaxTerminals> const& subset, bool allow_mismatch) {
     auto const index = _indexer.get_index_or_insert(subset, allow_mismatch);
     if (index >= _storage.size()) {
         _storage.resize(index + 1, _initial_value);
     }
+    _num_used = std::max(_num_used, index + 1);
     return _storage[index];
 }
 
-template<class T>
-T const& SubsetMap<T>::get_or_default(TerminalSubset const& subset, bool allow_mismatch) const {
+template<TerminalIndex MaxTerminals, class T>
+void SubsetMap<MaxTerminals, T>::reset() {
+    // Assign instead of clearing the vector, so that e.g. vectors stored in the map keep their memory
+    std::fill(_storage.begin(), _storage.begin() + _num_used, _initial_value);
+    _num_used = 0;
+    if (_storage.size() < _indexer.num_dense_indices()) {
+        _storage.resize(_indexer.num_dense_indices(), _initial_value);
+    }
+}
+
+template<TerminalIndex MaxTerminals, class T>
+T const& SubsetMap<MaxTerminals, T>::get_or_default(
+    TerminalSubset<MaxTerminals> const& subset, bool allow_mismatch
+) const {
     auto const index = _indexer.get_index_for(subset, allow_mismatch);
     if (not index.has_value() or index.value() >= _storage.size()) {
         return _initial_value;
@@ -113,4 +229,71 @@ T const& SubsetMap<T>::get_or_default(TerminalSubset const& subset, bool allow_m
     }
 }
 
+template<TerminalIndex MaxTerminals, class T>
+LabelMap<MaxTerminals, T>::LabelMap(
+    HananGrid<MaxTerminals> const& grid, SubsetIndexer<MaxTerminals>& indexer, T initial, VertexIndex const page_size
+):
+    _page_tables(indexer),
+    _num_vertices(grid.num_vertices()),
+    _page_shift(std::bit_width(static_cast<unsigned>(std::max<VertexIndex>(page_size, 1) - 1))),
+    _page_mask((VertexIndex{1} << _page_shift) - 1),
+    _initial_value(initial) {}
+
+template<TerminalIndex MaxTerminals, class T>
+typename std::vector<T>::reference LabelMap<MaxTerminals, T>::get_or_insert(
+    Label<MaxTerminals> const& label, bool const allow_mismatch
+) {
+    auto& page_table = _page_tables.get_or_insert(label.second, allow_mismatch);
+    if (page_table.empty()) {
+        page_table.resize(((_num_vertices - 1) >> _page_shift) + 1, no_page);
+        ++_num_page_tables;
+    }
+    auto const vertex = label.first.global_index;
+    auto& page_offset = page_table[vertex >> _page_shift];
+    if (page_offset == no_page) {
+        page_offset = _pages.size();
+        // The last page only covers the remaining vertices
+        auto const page_start = vertex & ~_page_mask;
+        auto const page_length = std::min<std::size_t>(_page_mask + 1, _num_vertices - page_start);
+        _pages.resize(_pages.size() + page_length, _initial_value);
+    }
+    return _pages[page_offset + (vertex & _page_mask)];
+}
+
+template<TerminalIndex MaxTerminals, class T>
+typename std::vector<T>::const_reference LabelMap<MaxTerminals, T>::get_or_default(
+    Label<MaxTerminals> const& label, bool const allow_mismatch
+) const {
+    auto const& page_table = _page_tables.get_or_default(label.second, allow_mismatch);
+    if (page_table.empty()) {
+        return _initial_value;
+    }
+    auto const vertex = label.first.global_index;
+    auto const page_offset = page_table[vertex >> _page_shift];
+    if (page_offset == no_page) {
+        return _initial_value;
+    }
+    return _pages[page_offset + (vertex & _page_mask)];
+}
+
+template<TerminalIndex MaxTerminals, class T>
+void LabelMap<MaxTerminals, T>::reset(HananGrid<MaxTerminals> const& grid) {
+    _page_tables.reset();
+    _pages.clear();
+    _num_page_tables = 0;
+    _num_vertices = grid.num_vertices();
+}
+
+template<TerminalIndex MaxTerminals, class T>
+std::size_t LabelMap<MaxTerminals, T>::used_bytes() const {
+    std::size_t page_bytes;
+    if constexpr (std::is_same_v<T, bool>) {
+        page_bytes = _pages.size() / 8;
+    } else {
+        page_bytes = _pages.size() * sizeof(T);
+    }
+    auto const num_pages_per_subset = ((_num_vertices - 1) >> _page_shift) + 1;
+    return page_bytes + _num_page_tables * num_pages_per_subset * sizeof(PageOffset);
+}
+
 #endif
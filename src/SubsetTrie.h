@@ -0,0 +1,175 @@
+#ifndef SUBSET_TRIE_H
+#define SUBSET_TRIE_H
+
+#include "TypeDefs.h"
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <tuple>
+#include <utility>
+
+template<typename T, TerminalIndex MaxTerminals>
+concept SubsetConsumer = requires(T a, TerminalSubset<MaxTerminals> l, Cost c) {
+    a(l, c);
+};
+
+/**
+ * Stores pairs of terminal subsets and costs and enumerates the stored subsets disjoint to a given query set. The
+ * subsets are kept in a few runs sorted by their bitmask, which makes each run an implicit binary trie on the bits
+ * (most significant bit first): The subsets sharing the bits above some bit form a contiguous range, which is split in
+ * two by the first subset containing that bit. A query only visits the part of a range not containing the bit if the
+ * query set contains it, and skips ranges whose common bits meet the query set. Small ranges are scanned linearly,
+ * since this is faster than splitting them further.
+ * New subsets are appended to an unsorted tail, which is sorted into a new run once it holds max_scanned_range subsets.
+ * Runs are merged like the digits of a binary counter, so there are O(log n) runs and insert takes amortized O(log n)
+ * time instead of the O(n) of inserting into a single sorted array.
+ * The bitmasks are stored in the smallest integer type that can hold them, so narrow instances scan less memory.
+ */
+template<TerminalIndex MaxTerminals>
+class SubsetTrie {
+public:
+    /// Ranges of at most this many subsets are scanned linearly
+    static std::size_t constexpr max_scanned_range = 128;
+
+    /// Calls the consumer with each stored subset disjoint to query, and the cost stored with it
+    template<SubsetConsumer<MaxTerminals> Consumer>
+    void for_each_disjoint(TerminalSubset<MaxTerminals> const& query, Consumer const& out) const;
+
+    /// Stores the given subset, which must not be stored already
+    void insert(TerminalSubset<MaxTerminals> const& subset, Cost cost);
+
+    [[nodiscard]] std::size_t size() const { return _subsets.size(); }
+
+    /// Removes all subsets, keeping the allocated memory
+    void clear() {
+        _subsets.clear();
+        _costs.clear();
+        _run_ends.clear();
+    }
+private:
+    using Bits = SubsetBits<MaxTerminals>;
+
+    template<SubsetConsumer<MaxTerminals> Consumer>
+    void for_each_disjoint(std::size_t begin, std::size_t end, Bits query, Consumer const& out) const;
+
+    template<SubsetConsumer<MaxTerminals> Consumer>
+    void scan_disjoint(std::size_t begin, std::size_t end, Bits query, Consumer const& out) const;
+
+    [[nodiscard]] std::size_t sorted_end() const { return _run_ends.empty() ? 0 : _run_ends.back(); }
+
+    /// Sorts the tail into a new run and merges the last runs while they are no longer than the run following them
+    void sort_tail();
+
+    /// Bitmasks of the stored subsets: The sorted runs in order of decreasing length, followed by the unsorted tail
+    std::vector<Bits> _subsets;
+    /// _costs[i] is the cost stored with _subsets[i]
+    std::vector<Cost> _costs;
+    /// The end index of each sorted run in _subsets
+    std::vector<std::size_t> _run_ends;
+    /// Scratch buffers for sorting the tail and merging runs, kept to avoid reallocations
+    std::vector<std::pair<Bits, Cost>> _sort_buffer;
+    std::vector<Bits> _merged_subsets;
+    std::vector<Cost> _merged_costs;
+};
+
+template<TerminalIndex MaxTerminals>
+template<SubsetConsumer<MaxTerminals> Consumer>
+void SubsetTrie<MaxTerminals>::for_each_disjoint(
+    TerminalSubset<MaxTerminals> const& query, Consumer const& out
+) const {
+    auto const bits = static_cast<Bits>(query.to_ulong());
+    std::size_t run_begin = 0;
+    for (auto const run_end : _run_ends) {
+        for_each_disjoint(run_begin, run_end, bits, out);
+        run_begin = run_end;
+    }
+    scan_disjoint(run_begin, _subsets.size(), bits, out);
+}
+
+template<TerminalIndex MaxTerminals>
+template<SubsetConsumer<MaxTerminals> Consumer>
+void SubsetTrie<MaxTerminals>::scan_disjoint(
+    std::size_t const begin, std::size_t const end, Bits const query, Consumer const& out
+) const {
+    for (auto i = begin; i < end; ++i) {
+        if ((_subsets[i] & query) == 0) {
+            out(TerminalSubset<MaxTerminals>{_subsets[i]}, _costs[i]);
+        }
+    }
+}
+
+template<TerminalIndex MaxTerminals>
+template<SubsetConsumer<MaxTerminals> Consumer>
+void SubsetTrie<MaxTerminals>::for_each_disjoint(
+    std::size_t const begin, std::size_t const end, Bits const query, Consumer const& out
+) const {
+    if (end - begin <= max_scanned_range) {
+        scan_disjoint(begin, end, query, out);
+        return;
+    }
+    // All subsets in the range agree on the bits above split_bit, since the range is sorted
+    auto const first = _subsets[begin];
+    auto const split_bit = std::bit_width(static_cast<unsigned long>(first ^ _subsets[end - 1])) - 1;
+    auto const common_mask = ~0ul << split_bit << 1;
+    if ((first & common_mask & query) != 0) {
+        return;
+    }
+    auto const split_mask = 1ul << split_bit;
+    auto const split = std::partition_point(
+        _subsets.begin() + begin, _subsets.begin() + end, [&](auto const subset) { return (subset & split_mask) == 0; }
+    ) - _subsets.begin();
+    for_each_disjoint(begin, split, query, out);
+    if ((query & split_mask) == 0) {
+        for_each_disjoint(split, end, query, out);
+    }
+}
+
+template<TerminalIndex MaxTerminals>
+void SubsetTrie<MaxTerminals>::insert(TerminalSubset<MaxTerminals> const& subset, Cost const cost) {
+    _subsets.push_back(static_cast<Bits>(subset.to_ulong()));
+    _costs.push_back(cost);
+    if (_subsets.size() - sorted_end() >= max_scanned_range) {
+        sort_tail();
+    }
+}
+
+template<TerminalIndex MaxTerminals>
+void SubsetTrie<MaxTerminals>::sort_tail() {
+    auto const tail_begin = sorted_end();
+    _sort_buffer.clear();
+    for (auto i = tail_begin; i < _subsets.size(); ++i) {
+        _sort_buffer.emplace_back(_subsets[i], _costs[i]);
+    }
+    std::sort(_sort_buffer.begin(), _sort_buffer.end());
+    for (std::size_t i = 0; i < _sort_buffer.size(); ++i) {
+        std::tie(_subsets[tail_begin + i], _costs[tail_begin + i]) = _sort_buffer[i];
+    }
+    _run_ends.push_back(_subsets.size());
+    while (_run_ends.size() >= 2) {
+        auto const num_runs = _run_ends.size();
+        auto const second_end = _run_ends[num_runs - 1];
+        auto const first_end = _run_ends[num_runs - 2];
+        auto const first_begin = num_runs >= 3 ? _run_ends[num_runs - 3] : 0;
+        if (first_end - first_begin > second_end - first_end) {
+            break;
+        }
+        _merged_subsets.clear();
+        _merged_costs.clear();
+        auto first = first_begin;
+        auto second = first_end;
+        while (first < first_end or second < second_end) {
+            auto const take_first = second == second_end or (first < first_end and _subsets[first] < _subsets[second]);
+            auto const index = take_first ? first++ : second++;
+            assert(take_first or first == first_end or _subsets[index] != _subsets[first]);
+            _merged_subsets.push_back(_subsets[index]);
+            _merged_costs.push_back(_costs[index]);
+        }
+        std::copy(_merged_subsets.begin(), _merged_subsets.end(), _subsets.begin() + first_begin);
+        std::copy(_merged_costs.begin(), _merged_costs.end(), _costs.begin() + first_begin);
+        _run_ends.pop_back();
+        _run_ends.back() = second_end;
+    }
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include "TerminalDistanceMatrix.h"
+#include <limits>
+
+TerminalDistanceMatrix::TerminalDistanceMatrix(
+    std::size_t const num_rows, std::size_t const num_terminals, std::uint64_t const max_distance
+) {
+    reset(num_rows, num_terminals, max_distance);
+}
+
+void TerminalDistanceMatrix::reset(
+    std::size_t const num_rows, std::size_t const num_terminals, std::uint64_t const max_distance
+) {
+    _num_rows = num_rows;
+    _row_size = (num_terminals + chunk_size - 1) / chunk_size * chunk_size;
+    // The largest NarrowCost is reserved for padding, so that it never equals a distance
+    _narrow = max_distance < std::numeric_limits<NarrowCost>::max();
+    if (_narrow) {
+        _narrow_entries.assign(_num_rows * _row_size, std::numeric_limits<NarrowCost>::max());
+        _wide_entries.clear();
+    } else {
+        _wide_entries.assign(_num_rows * _row_size, invalid_cost);
+        _narrow_entries.clear();
+    }
+}
+
+void TerminalDistanceMatrix::set(std::size_t const row, TerminalIndex const terminal, Cost const distance) {
+    assert(row < _num_rows and terminal < _row_size);
+    if (_narrow) {
+        assert(distance < std::numeric_limits<NarrowCost>::max());
+        _narrow_entries.at(row * _row_size + terminal) = static_cast<NarrowCost>(distance);
+    } else {
+        _wide_entries.at(row * _row_size + terminal) = distance;
+    }
+}
+
+std::size_t TerminalDistanceMatrix::add_row() {
+    if (_narrow) {
+        _narrow_entries.resize(_narrow_entries.size() + _row_size, std::numeric_limits<NarrowCost>::max());
+    } else {
+        _wide_entries.resize(_wide_entries.size() + _row_size, invalid_cost);
+    }
+    return _num_rows++;
+}
+
+std::size_t TerminalDistanceMatrix::allocated_bytes() const {
+    return _narrow_entries.capacity() * sizeof(NarrowCost) + _wide_entries.capacity() * sizeof(Cost);
+}
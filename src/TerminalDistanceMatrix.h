@@ -0,0 +1,118 @@
+#ifndef TERMINAL_DISTANCE_MATRIX_H
+#define TERMINAL_DISTANCE_MATRIX_H
+
+#include "TypeDefs.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/// Allocates with the given alignment, which may exceed that of T
+template<class T, std::size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template<class U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template<class U>
+    explicit AlignedAllocator(AlignedAllocator<U, Alignment> const&) {}
+
+    [[nodiscard]] T* allocate(std::size_t const n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+    }
+
+    void deallocate(T* const p, std::size_t) {
+        ::operator delete(p, std::align_val_t{Alignment});
+    }
+
+    bool operator==(AlignedAllocator const&) const = default;
+};
+
+/**
+ * The distances from each vertex of a Hanan grid to all terminals, stored row by row in one buffer. The entries have 16
+ * bits if the L1 diameter of the bounding box of the terminals permits it, and 32 bits otherwise. Each row is padded
+ * to a multiple of chunk_size entries and the buffer is aligned to a cache line, so every chunk can be read with a
+ * single aligned vector load. For 20 terminals, a row takes 48 bytes instead of 80 for an array of MaxTerminals Costs.
+ */
+class TerminalDistanceMatrix {
+public:
+    using NarrowCost = std::uint16_t;
+    /// The number of entries that are loaded at once by the distance kernels
+    static std::size_t constexpr chunk_size = 8;
+    static std::size_t constexpr alignment = 64;
+
+    /// The distances from one vertex to all terminals
+    class Row {
+    public:
+        Row(void const* entries, std::size_t num_chunks, bool narrow) :
+            _entries(entries), _num_chunks(num_chunks), _narrow(narrow) {}
+
+        /// The number of chunks of chunk_size entries, including padding
+        [[nodiscard]] std::size_t num_chunks() const { return _num_chunks; }
+
+        /// The entries, which are NarrowCost if is_narrow and Cost otherwise
+        [[nodiscard]] void const* data() const { return _entries; }
+
+        [[nodiscard]] bool is_narrow() const { return _narrow; }
+
+        /// Calls function with a pointer to the entries, either NarrowCost const* or Cost const*
+        template<class Function>
+        auto visit(Function const& function) const {
+            return _narrow ? function(static_cast<NarrowCost const*>(_entries))
+                : function(static_cast<Cost const*>(_entries));
+        }
+
+        [[nodiscard]] Cost operator[](TerminalIndex const terminal) const {
+            return visit([terminal](auto const* entries) { return Cost{entries[terminal]}; });
+        }
+    private:
+        void const* _entries;
+        std::size_t _num_chunks;
+        bool _narrow;
+    };
+
+    TerminalDistanceMatrix() = default;
+
+    /**
+     * A matrix with num_rows rows of num_terminals distances, each of which is at most max_distance. Entries start as
+     * the largest value of their type, which is also kept in the padding.
+     */
+    TerminalDistanceMatrix(std::size_t num_rows, std::size_t num_terminals, std::uint64_t max_distance);
+
+    /// Makes this a matrix as created by the constructor with these arguments, keeping the allocated memory
+    void reset(std::size_t num_rows, std::size_t num_terminals, std::uint64_t max_distance);
+
+    /// Appends a row whose entries have the initial value and returns its index
+    std::size_t add_row();
+
+    void set(std::size_t row, TerminalIndex terminal, Cost distance);
+
+    [[nodiscard]] Row row(std::size_t const index) const {
+        assert(index < _num_rows);
+        if (_narrow) {
+            return {_narrow_entries.data() + index * _row_size, _row_size / chunk_size, true};
+        }
+        return {_wide_entries.data() + index * _row_size, _row_size / chunk_size, false};
+    }
+
+    /// Whether the entries are stored as NarrowCost
+    [[nodiscard]] bool is_narrow() const { return _narrow; }
+
+    [[nodiscard]] std::size_t allocated_bytes() const;
+private:
+    std::size_t _num_rows = 0;
+    /// The number of entries per row, a multiple of chunk_size
+    std::size_t _row_size = 0;
+    bool _narrow = false;
+    /// Only the vector of the chosen width is used
+    std::vector<NarrowCost, AlignedAllocator<NarrowCost, alignment>> _narrow_entries;
+    std::vector<Cost, AlignedAllocator<Cost, alignment>> _wide_entries;
+};
+
+#endif
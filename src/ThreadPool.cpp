@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t const num_threads) : _ranges(std::max<std::size_t>(num_threads, 1)) {
+    for (std::size_t i = 1; i < num_threads; ++i) {
+        _workers.emplace_back([this, i]() { run_worker(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard const lock(_mutex);
+        _stopping = true;
+    }
+    _loop_started.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t const num_tasks, std::function<void(std::size_t)> const& task) {
+    if (_workers.empty() or num_tasks <= 1) {
+        for (std::size_t i = 0; i < num_tasks; ++i) {
+            task(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard const lock(_mutex);
+        _task = &task;
+        for (std::size_t thread = 0; thread < _ranges.size(); ++thread) {
+            std::lock_guard const range_lock(_ranges[thread].mutex);
+            _ranges[thread].begin = thread * num_tasks / _ranges.size();
+            _ranges[thread].end = (thread + 1) * num_tasks / _ranges.size();
+        }
+        _num_busy_workers = _workers.size();
+        ++_loop_id;
+    }
+    _loop_started.notify_all();
+    run_tasks(0);
+    std::unique_lock lock(_mutex);
+    _loop_finished.wait(lock, [this]() { return _num_busy_workers == 0; });
+    _task = nullptr;
+}
+
+void ThreadPool::run_worker(std::size_t const thread_index) {
+    std::size_t last_loop_id = 0;
+    while (true) {
+        {
+            std::unique_lock lock(_mutex);
+            _loop_started.wait(lock, [&]() { return _stopping or _loop_id != last_loop_id; });
+            if (_stopping) {
+                return;
+            }
+            last_loop_id = _loop_id;
+        }
+        run_tasks(thread_index);
+        bool last_worker;
+        {
+            std::lock_guard const lock(_mutex);
+            last_worker = --_num_busy_workers == 0;
+        }
+        if (last_worker) {
+            _loop_finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run_tasks(std::size_t const thread_index) {
+    while (true) {
+        if (auto const task_index = take_own_task(thread_index)) {
+            (*_task)(task_index.value());
+        } else if (not steal_tasks(thread_index)) {
+            return;
+        }
+    }
+}
+
+std::optional<std::size_t> ThreadPool::take_own_task(std::size_t const thread_index) {
+    auto& range = _ranges[thread_index];
+    std::lock_guard const lock(range.mutex);
+    if (range.begin == range.end) {
+        return std::nullopt;
+    }
+    return range.begin++;
+}
+
+bool ThreadPool::steal_tasks(std::size_t const thread_index) {
+    while (true) {
+        std::size_t victim = thread_index;
+        std::size_t victim_size = 0;
+        for (std::size_t other = 0; other < _ranges.size(); ++other) {
+            std::lock_guard const lock(_ranges[other].mutex);
+            auto const size = _ranges[other].end - _ranges[other].begin;
+            if (other != thread_index and size > victim_size) {
+                victim = other;
+                victim_size = size;
+            }
+        }
+        if (victim_size == 0) {
+            return false;
+        }
+        // scoped_lock avoids deadlocks with other threads stealing from our range at the same time
+        std::scoped_lock const lock(_ranges[victim].mutex, _ranges[thread_index].mutex);
+        auto& victim_range = _ranges[victim];
+        auto const size = victim_range.end - victim_range.begin;
+        // The victim may have made progress since we looked at it
+        if (size == 0) {
+            continue;
+        }
+        auto& own_range = _ranges[thread_index];
+        own_range.end = victim_range.end;
+        victim_range.end -= (size + 1) / 2;
+        own_range.begin = victim_range.end;
+        return true;
+    }
+}
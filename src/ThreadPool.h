@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <optional>
+#include <cstddef>
+
+/**
+ * A fixed set of worker threads for data-parallel loops. The thread calling parallel_for takes part in the loop, so a
+ * pool with num_threads threads only starts num_threads - 1 workers.
+ * Loops are scheduled by work stealing: Each thread starts with a contiguous range of the loop indices and takes
+ * indices from the front of its range. A thread whose range is empty steals the back half of the largest remaining
+ * range of another thread.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t num_threads);
+
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    [[nodiscard]] std::size_t num_threads() const { return _workers.size() + 1; }
+
+    /**
+     * Calls task(i) for each i < num_tasks, distributing the calls over all threads. Returns once all calls have
+     * returned. Must not be called concurrently or from within a task.
+     */
+    void parallel_for(std::size_t num_tasks, std::function<void(std::size_t)> const& task);
+
+private:
+    /// The loop indices currently owned by one thread
+    struct TaskRange {
+        std::mutex mutex;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    void run_worker(std::size_t thread_index);
+
+    /// Runs tasks of the current loop until none are left, starting with the range of the given thread
+    void run_tasks(std::size_t thread_index);
+
+    /// Takes the next index from the range of the given thread, or std::nullopt if it is empty
+    [[nodiscard]] std::optional<std::size_t> take_own_task(std::size_t thread_index);
+
+    /// Moves half of the largest range of another thread to the range of the given thread, returns false if all are empty
+    [[nodiscard]] bool steal_tasks(std::size_t thread_index);
+
+    std::vector<std::thread> _workers;
+    /// One range per thread, the calling thread has index 0
+    std::vector<TaskRange> _ranges;
+    std::mutex _mutex;
+    std::condition_variable _loop_started;
+    std::condition_variable _loop_finished;
+    std::function<void(std::size_t)> const* _task = nullptr;
+    /// Number of workers that have not finished the current loop yet
+    std::size_t _num_busy_workers = 0;
+    /// Incremented for each loop, so workers can tell a new loop from a spurious wakeup
+    std::size_t _loop_id = 0;
+    bool _stopping = false;
+};
+
+#endif
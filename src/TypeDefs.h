@@ -7,6 +7,8 @@
 #include <queue>
 #include <array>
 #include <cmath>
+#include <optional>
+#include <type_traits>
 
 using Coord = std::uint32_t;
 std::size_t constexpr num_dimensions = 3;
@@ -15,20 +17,43 @@ using Point = std::array<Coord, num_dimensions>;
 auto constexpr invalid_cost = std::numeric_limits<Cost>::max();
 
 using TerminalIndex = std::uint8_t;
-TerminalIndex constexpr max_num_terminals = 20;
-using TerminalSubset = std::bitset<max_num_terminals>;
+/// The largest number of terminals supported, i.e. the largest of the terminal_widths
+TerminalIndex constexpr max_num_terminals = 64;
+/**
+ * The solver is instantiated for each of these maximum numbers of terminals, and an instance is solved by the
+ * instantiation with the smallest sufficient width. This way masks, array sizes and loop bounds are compile-time
+ * constants, and small instances do not pay for the largest width.
+ */
+std::array<TerminalIndex, 7> constexpr terminal_widths{4, 8, 12, 16, 20, 32, max_num_terminals};
 
-using VertexIndex = std::uint16_t;
+/// Subsets of the terminals of an instance with at most MaxTerminals terminals
+template<TerminalIndex MaxTerminals>
+using TerminalSubset = std::bitset<MaxTerminals>;
+
+/// The smallest unsigned integer type holding the bitmask of a TerminalSubset<MaxTerminals>
+template<TerminalIndex MaxTerminals>
+using SubsetBits = std::conditional_t<
+    MaxTerminals <= 8, std::uint8_t, std::conditional_t<
+        MaxTerminals <= 16, std::uint16_t, std::conditional_t<MaxTerminals <= 32, std::uint32_t, std::uint64_t>
+    >
+>;
+
+/// The maximum number of vertices of the Hanan grid of an instance with the given number of terminals
+constexpr std::size_t get_max_num_vertices(std::size_t const num_terminals) {
+    std::size_t result = 1;
+    for (std::size_t i = 0; i < num_dimensions; ++i) {
+        result *= num_terminals;
+    }
+    return result;
+}
+
+/// Indices of the vertices of the Hanan grid of an instance with at most MaxTerminals terminals
+template<TerminalIndex MaxTerminals>
+using VertexIndex = std::conditional_t<
+    (get_max_num_vertices(MaxTerminals) < std::numeric_limits<std::uint16_t>::max()), std::uint16_t, std::uint32_t
+>;
 // Assert that VertexIndex is large enough to hold the maximum number of grid vertices
-static_assert(
-    []() constexpr -> std::size_t {
-        auto const as_size_t = static_cast<std::size_t>(max_num_terminals);
-        std::size_t result = 1;
-        for (std::size_t i = 0; i < num_dimensions; ++i) {
-            result *= as_size_t;
-        }
-        return result;
-    }() < std::numeric_limits<VertexIndex>::max());
+static_assert(get_max_num_vertices(max_num_terminals) < std::numeric_limits<VertexIndex<max_num_terminals>>::max());
 
 template<class T>
 using MinHeap = std::priority_queue<T, std::vector<T>, std::greater<T>>;
@@ -49,11 +74,16 @@ std::is_convertible_v<From, To> && requires(std::add_rvalue_reference_t<From> (&
 
 #endif
 
-template<class Callback>
+/// The mask of the lowest num_bits bits, also for num_bits = 64
+constexpr std::uint64_t get_low_bits_mask(std::size_t const num_bits) {
+    return num_bits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << num_bits) - 1;
+}
+
+template<std::size_t NumBits, class Callback>
 void for_each_set_bit(
-    TerminalSubset const& set, std::size_t num_terminals, Callback const& cb
+    std::bitset<NumBits> const& set, std::size_t num_terminals, Callback const& cb
 ) {
-    std::uint64_t bitset = set.to_ulong() & ((1 << num_terminals) - 1);
+    std::uint64_t bitset = set.to_ullong() & get_low_bits_mask(num_terminals);
     // Copied from https://lemire.me/blog/2018/02/21/iterating-over-set-bits-quickly/
     while (bitset != 0) {
         std::uint64_t t = bitset & -bitset;
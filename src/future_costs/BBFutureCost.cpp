@@ -1,6 +1,7 @@
 #include "BBFutureCost.h"
 
-Cost BBFutureCost::operator()(Label const& label) const {
+template<TerminalIndex MaxTerminals>
+Cost BBFutureCost<MaxTerminals>::operator()(Label<MaxTerminals> const& label) const {
     auto grid_min = label.first.indices;
     auto grid_max = label.first.indices;
     auto const& terminals = _grid.get_terminals();
@@ -10,5 +11,14 @@ Cost BBFutureCost::operator()(Label const& label) const {
             grid_max = terminals[terminal].max(grid_max);
         }
     );
-    return HananGrid::get_distance(_grid.to_coordinates(grid_min), _grid.to_coordinates(grid_max));
+    return get_distance(_grid.to_coordinates(grid_min), _grid.to_coordinates(grid_max));
 }
+
+// One instantiation for each of the terminal_widths
+template class BBFutureCost<4>;
+template class BBFutureCost<8>;
+template class BBFutureCost<12>;
+template class BBFutureCost<16>;
+template class BBFutureCost<20>;
+template class BBFutureCost<32>;
+template class BBFutureCost<64>;
@@ -3,14 +3,17 @@
 
 #include "FutureCost.h"
 
+template<TerminalIndex MaxTerminals>
 class BBFutureCost {
 public:
-    BBFutureCost(HananGrid const& grid, SubsetIndexer&): _grid(grid) {}
-    Cost operator()(Label const& label) const;
+    BBFutureCost(HananGrid<MaxTerminals> const& grid, SubsetIndexer<MaxTerminals>&): _grid(grid) {}
+    Cost operator()(Label<MaxTerminals> const& label) const;
+
+    void reset() {}
 private:
-    HananGrid const& _grid;
+    HananGrid<MaxTerminals> const& _grid;
 };
 
-static_assert(FutureCost<BBFutureCost>);
+static_assert(FutureCost<BBFutureCost<max_num_terminals>, max_num_terminals>);
 
 #endif
@@ -3,11 +3,28 @@
 
 #include "../HananGrid.h"
 #include "../SubsetIndexer.h"
+#include "../ThreadPool.h"
 
-template<typename T>
-concept FutureCost = requires(T const a, Label l, HananGrid const grid, SubsetIndexer indexer) {
+/**
+ * A future cost is constructed from the grid and the indexer of the solver, which keeps both alive. reset is called
+ * after the grid has been replaced and the indexer has been reset.
+ */
+template<typename T, TerminalIndex MaxTerminals>
+concept FutureCost = requires(
+    T const a, T b, Label<MaxTerminals> l, HananGrid<MaxTerminals> const grid, SubsetIndexer<MaxTerminals> indexer
+) {
     T{grid, indexer};
     { a(l) } -> std::convertible_to<Cost>;
+    b.reset();
+};
+
+/**
+ * A future cost which can fill its tables before the search starts. precompute is called once per instance after
+ * construction or reset, with the thread pool of the solver or nullptr if the solver runs single-threaded.
+ */
+template<typename T, TerminalIndex MaxTerminals>
+concept PrecomputedFutureCost = FutureCost<T, MaxTerminals> and requires(T b, ThreadPool* thread_pool) {
+    b.precompute(thread_pool);
 };
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef FUTURE_COST_SELECTION_H
+#define FUTURE_COST_SELECTION_H
+
+#include "FutureCost.h"
+#include "NullFutureCost.h"
+#include "BBFutureCost.h"
+#include "OneTreeFutureCost.h"
+#include "MaxFutureCost.h"
+#include <array>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+/// The future costs which can be chosen at runtime, see dispatch_future_cost
+enum class FutureCostKind : std::uint8_t {
+    null,
+    bb,
+    one_tree,
+    /// The maximum of the 1-tree and the bounding box future cost
+    max
+};
+
+/// The future cost of FutureCostKind::max, which is the default
+template<TerminalIndex MaxTerminals>
+using OneTreeBBFutureCost = MaxFutureCost<MaxTerminals, OneTreeFutureCost<MaxTerminals>, BBFutureCost<MaxTerminals>>;
+
+/// The future cost types for each FutureCostKind, in the order of the enum
+template<TerminalIndex MaxTerminals>
+using SelectableFutureCosts = std::tuple<
+    NullFutureCost<MaxTerminals>, BBFutureCost<MaxTerminals>, OneTreeFutureCost<MaxTerminals>,
+    OneTreeBBFutureCost<MaxTerminals>
+>;
+
+/// The names of the FutureCostKinds, as used on the command line
+std::array<std::string_view, 4> constexpr future_cost_names{"null", "bb", "one-tree", "max"};
+
+[[nodiscard]] inline std::optional<FutureCostKind> parse_future_cost_kind(std::string_view const name) {
+    for (std::size_t kind = 0; kind < future_cost_names.size(); ++kind) {
+        if (future_cost_names.at(kind) == name) {
+            return static_cast<FutureCostKind>(kind);
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * Calls function.template operator()<FC>() for the future cost FC of the given kind, and returns the result. The
+ * function is instantiated for all SelectableFutureCosts and the instantiation is looked up in a table, so the choice
+ * costs a single indirect call, while the search itself runs with the future cost known at compile time.
+ */
+template<TerminalIndex MaxTerminals, class Function>
+auto dispatch_future_cost(FutureCostKind const kind, Function const& function) {
+    using Costs = SelectableFutureCosts<MaxTerminals>;
+    static_assert(std::tuple_size_v<Costs> == future_cost_names.size());
+    return [&]<std::size_t... Kinds>(std::index_sequence<Kinds...>) {
+        using Result = decltype(function.template operator()<std::tuple_element_t<0, Costs>>());
+        std::array<Result (*)(Function const&), sizeof...(Kinds)> constexpr table{
+            [](Function const& f) -> Result {
+                return f.template operator()<std::tuple_element_t<Kinds, Costs>>();
+            }...
+        };
+        return table.at(static_cast<std::size_t>(kind))(function);
+    }(std::make_index_sequence<std::tuple_size_v<Costs>>{});
+}
+
+#endif
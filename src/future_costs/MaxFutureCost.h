@@ -3,17 +3,31 @@
 
 #include "FutureCost.h"
 
-template<FutureCost CostA, FutureCost CostB>
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> CostA, FutureCost<MaxTerminals> CostB>
 class MaxFutureCost {
 public:
-    explicit MaxFutureCost(HananGrid const& grid, SubsetIndexer& indexer) :
+    explicit MaxFutureCost(HananGrid<MaxTerminals> const& grid, SubsetIndexer<MaxTerminals>& indexer) :
         _cost_a{grid, indexer},
         _cost_b{grid, indexer} {}
 
-    Cost operator()(Label const& label) const {
+    Cost operator()(Label<MaxTerminals> const& label) const {
         return std::max(_cost_a(label), _cost_b(label));
     }
 
+    void reset() {
+        _cost_a.reset();
+        _cost_b.reset();
+    }
+
+    void precompute(ThreadPool* const thread_pool) {
+        if constexpr (PrecomputedFutureCost<CostA, MaxTerminals>) {
+            _cost_a.precompute(thread_pool);
+        }
+        if constexpr (PrecomputedFutureCost<CostB, MaxTerminals>) {
+            _cost_b.precompute(thread_pool);
+        }
+    }
+
 private:
     CostA _cost_a;
     CostB _cost_b;
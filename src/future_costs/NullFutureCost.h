@@ -3,12 +3,15 @@
 
 #include "FutureCost.h"
 
+template<TerminalIndex MaxTerminals>
 struct NullFutureCost {
-    NullFutureCost(HananGrid const&, SubsetIndexer&) {}
+    NullFutureCost(HananGrid<MaxTerminals> const&, SubsetIndexer<MaxTerminals>&) {}
 
-    Cost operator()(Label const&, bool) const { return 0; }
+    Cost operator()(Label<MaxTerminals> const&) const { return 0; }
+
+    void reset() {}
 };
 
-static_assert(FutureCost<NullFutureCost>);
+static_assert(FutureCost<NullFutureCost<max_num_terminals>, max_num_terminals>);
 
 #endif
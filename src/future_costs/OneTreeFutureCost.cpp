@@ -1,33 +1,42 @@
 #include "OneTreeFutureCost.h"
+#include "../DistanceKernels.h"
 #include <limits>
 #include <cassert>
+#include <algorithm>
 
-OneTreeFutureCost::OneTreeFutureCost(HananGrid const& grid, SubsetIndexer& indexer) :
+template<TerminalIndex MaxTerminals>
+OneTreeFutureCost<MaxTerminals>::OneTreeFutureCost(
+    HananGrid<MaxTerminals> const& grid, SubsetIndexer<MaxTerminals>& indexer
+) :
     _grid(grid),
-    _known_tree_costs(indexer, invalid_cost) {
-    for (TerminalIndex index_a = 0; index_a < grid.num_terminals(); ++index_a) {
-        auto const vertex_index = grid.get_terminals().at(index_a).global_index;
-        _terminal_distances.at(index_a) = grid.get_distances_to_terminals(vertex_index);
+    _indexer(indexer) {
+    reset();
+}
+
+template<TerminalIndex MaxTerminals>
+void OneTreeFutureCost<MaxTerminals>::reset() {
+    for (TerminalIndex index_a = 0; index_a < _grid.num_terminals(); ++index_a) {
+        auto const vertex_index = _grid.get_terminals().at(index_a).global_index;
+        auto const distances = _grid.get_distances_to_terminals(vertex_index);
+        for (TerminalIndex index_b = 0; index_b < _grid.num_terminals(); ++index_b) {
+            _terminal_distances.at(index_a).at(index_b) = distances[index_b];
+        }
     }
+    if (_indexer.is_dense()) {
+        _known_tree_costs.reset();
+    } else if (_known_tree_costs.has_value()) {
+        _known_tree_costs->reset();
+    } else {
+        _known_tree_costs.emplace(_indexer, invalid_cost);
+    }
+    _all_tree_costs.clear();
 }
 
-Cost OneTreeFutureCost::operator()(Label const& label) const {
+template<TerminalIndex MaxTerminals>
+Cost OneTreeFutureCost<MaxTerminals>::operator()(Label<MaxTerminals> const& label) const {
     // Find cheapest edges to complete the 1-tree (combined with an MST on ~label.second)
-    Cost min_edge = invalid_cost;
-    Cost second_min_edge = invalid_cost;
-    auto const& distances = _grid.get_distances_to_terminals(label.first.global_index);
-    for_each_set_bit(
-        ~label.second, _grid.num_terminals(), [&](auto const set_bit) {
-            auto const cost = distances[set_bit];
-            if (cost < second_min_edge) {
-                if (cost <= min_edge) {
-                    second_min_edge = min_edge;
-                    min_edge = cost;
-                } else {
-                    second_min_edge = cost;
-                }
-            }
-        }
+    auto const[min_edge, second_min_edge] = _grid.get_distance_kernels().masked_two_smallest(
+        _grid.get_distances_to_terminals(label.first.global_index), ~label.second, _grid.num_terminals()
     );
     auto const tree_cost = get_tree_cost(label.second);
     if (second_min_edge != invalid_cost) {
@@ -40,44 +49,226 @@ Cost OneTreeFutureCost::operator()(Label const& label) const {
     }
 }
 
-Cost OneTreeFutureCost::get_tree_cost(TerminalSubset const& label) const {
+template<TerminalIndex MaxTerminals>
+Cost OneTreeFutureCost<MaxTerminals>::get_tree_cost(TerminalSubset<MaxTerminals> const& label) const {
     assert(not label.test(_grid.num_terminals() - 1));
-    auto& cost = _known_tree_costs.get_or_insert(label);
-    if (cost != invalid_cost) {
-        return cost;
-    }
-    // Prims algorithm
-    std::vector<TerminalIndex> terminals_to_consider;
-    terminals_to_consider.reserve(_grid.num_terminals() - label.count());
-    for_each_set_bit(~label, _grid.num_terminals(), [&](auto const set_bit) {
-        terminals_to_consider.push_back(set_bit);
-    });
-    struct HeapEntry {
-        Cost edge_cost;
-        TerminalIndex connecting_terminal;
+    if (not _all_tree_costs.empty()) {
+        return _all_tree_costs[label.to_ulong()];
+    }
+    if (not _known_tree_costs.has_value()) {
+        // Dense, but precompute has not been called
+        return compute_tree_cost(label);
+    }
+    auto& cost = _known_tree_costs->get_or_insert(label);
+    if (cost == invalid_cost) {
+        cost = compute_tree_cost(label);
+    }
+    return cost;
+}
+
+template<TerminalIndex MaxTerminals>
+void OneTreeFutureCost<MaxTerminals>::precompute(ThreadPool* const thread_pool) {
+    _all_tree_costs.clear();
+    if (not _indexer.is_dense()) {
+        return;
+    }
+    auto const num_non_root_terminals = _grid.num_non_root_terminals();
+    _all_tree_costs.resize(std::size_t{1} << num_non_root_terminals);
+    SpanningTree root_tree{};
+    root_tree.order[0] = num_non_root_terminals;
+    root_tree.size = 1;
+    root_tree.cost = 0;
+    // Each task fills the trees containing a fixed set of the split_bits highest non-root terminals, and no others
+    // from that range
+    std::size_t split_bits = 0;
+    if (thread_pool != nullptr) {
+        while (split_bits < num_non_root_terminals and
+               (std::size_t{1} << split_bits) < 4 * thread_pool->num_threads() and
+               (std::size_t{1} << (num_non_root_terminals - split_bits - 1)) >= min_subsets_per_task) {
+            ++split_bits;
+        }
+    }
+    if (split_bits == 0) {
+        fill_tree_costs(root_tree, 0, num_non_root_terminals);
+        return;
+    }
+    TerminalIndex const first_split_terminal = num_non_root_terminals - split_bits;
+    thread_pool->parallel_for(
+        std::size_t{1} << split_bits, [&](std::size_t const task) {
+            auto tree = root_tree;
+            std::uint64_t const tree_terminals = std::uint64_t{task} << first_split_terminal;
+            for_each_set_bit(TerminalSubset<MaxTerminals>{tree_terminals}, num_non_root_terminals, [&](auto const bit) {
+                tree = insert_terminal(tree, bit);
+            });
+            fill_tree_costs(tree, tree_terminals, first_split_terminal);
+        }
+    );
+}
+
+template<TerminalIndex MaxTerminals>
+void OneTreeFutureCost<MaxTerminals>::fill_tree_costs(
+    SpanningTree const& tree, std::uint64_t const tree_terminals, TerminalIndex const next_terminal
+) {
+    // The table is indexed by the terminals not in the tree
+    _all_tree_costs[~tree_terminals & get_low_bits_mask(_grid.num_non_root_terminals())] = tree.cost;
+    // No further terminals are inserted into a tree containing terminal 0, so its structure is not needed
+    if (next_terminal > 0) {
+        auto const with_first = tree_terminals | 1;
+        _all_tree_costs[~with_first & get_low_bits_mask(_grid.num_non_root_terminals())] = get_insertion_cost(tree, 0);
+    }
+    for (TerminalIndex terminal = 1; terminal < next_terminal; ++terminal) {
+        fill_tree_costs(insert_terminal(tree, terminal), tree_terminals | (std::uint64_t{1} << terminal), terminal);
+    }
+}
 
-        bool operator>(HeapEntry const& other) const {
-            return edge_cost > other.edge_cost;
+template<TerminalIndex MaxTerminals>
+auto OneTreeFutureCost<MaxTerminals>::remove_cycle_maxima(
+    SpanningTree const& tree, TerminalIndex const new_terminal
+) const -> InsertionResult {
+    auto const& new_distances = _terminal_distances[new_terminal];
+    // For each terminal in the tree, the most expensive edge on the path to new_terminal in the part of the new tree
+    // built so far that contains the subtree of the terminal
+    std::array<InsertionEdge, MaxTerminals> max_edge_to_new;
+    InsertionResult result;
+    auto& keep_new_edge = result.keep_new_edge;
+    auto& keep_tree_edge = result.keep_tree_edge;
+    auto& cost = result.cost;
+    cost = tree.cost;
+    for (TerminalIndex i = 0; i < tree.size; ++i) {
+        auto const terminal = tree.order[i];
+        max_edge_to_new[terminal] = {new_distances[terminal], terminal, false};
+        keep_new_edge[terminal] = true;
+        keep_tree_edge[terminal] = i > 0;
+        cost += new_distances[terminal];
+    }
+    auto const remove = [&](InsertionEdge const& edge) {
+        (edge.is_tree_edge ? keep_tree_edge : keep_new_edge)[edge.terminal] = false;
+        cost -= edge.cost;
+    };
+    // Children before parents, so the subtree of a terminal is complete when it is attached to its parent
+    for (auto i = tree.size - 1; i > 0; --i) {
+        auto const terminal = tree.order[i];
+        auto const parent = tree.parent[terminal];
+        InsertionEdge const tree_edge{_terminal_distances[terminal][parent], terminal, true};
+        auto const& child_max = max_edge_to_new[terminal];
+        auto const child_side_max = tree_edge.cost >= child_max.cost ? tree_edge : child_max;
+        auto& parent_max = max_edge_to_new[parent];
+        // The cycle consists of tree_edge and the paths from both of its ends to new_terminal. If the removed edge is
+        // on the path from the parent, the new path goes through tree_edge.
+        if (parent_max.cost >= child_side_max.cost) {
+            remove(parent_max);
+            parent_max = child_side_max;
+        } else {
+            remove(child_side_max);
         }
+    }
+    return result;
+}
+
+template<TerminalIndex MaxTerminals>
+auto OneTreeFutureCost<MaxTerminals>::insert_terminal(
+    SpanningTree const& tree, TerminalIndex const new_terminal
+) const -> SpanningTree {
+    auto const[keep_new_edge, keep_tree_edge, cost] = remove_cycle_maxima(tree, new_terminal);
+    // Root the new tree at the root terminal again
+    std::array<std::array<TerminalIndex, MaxTerminals>, MaxTerminals> neighbors;
+    std::array<TerminalIndex, MaxTerminals> degree{};
+    auto const add_edge = [&](TerminalIndex const a, TerminalIndex const b) {
+        neighbors[a][degree[a]++] = b;
+        neighbors[b][degree[b]++] = a;
     };
-    MinHeap<HeapEntry> heap;
-    heap.push({0, terminals_to_consider.front()});
-    std::array<bool, max_num_terminals> is_connected{};
-    std::size_t num_connected = 0;
-    cost = 0;
-    while (num_connected < terminals_to_consider.size()) {
-        assert(not heap.empty());
-        auto const[edge_cost, new_terminal] = heap.top();
-        heap.pop();
-        if (is_connected.at(new_terminal)) { continue; }
-        is_connected.at(new_terminal) = true;
-        cost += edge_cost;
-        ++num_connected;
-        for (auto const other_terminal_id : terminals_to_consider) {
-            if (not is_connected.at(other_terminal_id)) {
-                heap.push({_terminal_distances.at(new_terminal).at(other_terminal_id), other_terminal_id});
+    for (TerminalIndex i = 0; i < tree.size; ++i) {
+        auto const terminal = tree.order[i];
+        if (keep_new_edge[terminal]) {
+            add_edge(terminal, new_terminal);
+        }
+        if (keep_tree_edge[terminal]) {
+            add_edge(terminal, tree.parent[terminal]);
+        }
+    }
+    SpanningTree result;
+    result.order[0] = tree.order[0];
+    result.size = 1;
+    result.cost = cost;
+    for (TerminalIndex i = 0; i < result.size; ++i) {
+        auto const terminal = result.order[i];
+        for (TerminalIndex j = 0; j < degree[terminal]; ++j) {
+            auto const neighbor = neighbors[terminal][j];
+            if (i == 0 or neighbor != result.parent[terminal]) {
+                result.parent[neighbor] = terminal;
+                result.order[result.size++] = neighbor;
             }
         }
     }
+    assert(result.size == tree.size + 1);
+    return result;
+}
+
+template<TerminalIndex MaxTerminals>
+Cost OneTreeFutureCost<MaxTerminals>::get_insertion_cost(
+    SpanningTree const& tree, TerminalIndex const new_terminal
+) const {
+    // The same cycles as in remove_cycle_maxima, but only tracking the costs of the edges allows doing it without
+    // branches: The most expensive edge of the cycle is removed, and the path from the parent to new_terminal only
+    // changes if it contained that edge.
+    auto const& new_distances = _terminal_distances[new_terminal];
+    std::array<Cost, MaxTerminals> max_cost_to_new;
+    Cost cost = tree.cost;
+    for (TerminalIndex i = 0; i < tree.size; ++i) {
+        auto const terminal = tree.order[i];
+        max_cost_to_new[terminal] = new_distances[terminal];
+        cost += new_distances[terminal];
+    }
+    for (auto i = tree.size - 1; i > 0; --i) {
+        auto const terminal = tree.order[i];
+        auto const parent = tree.parent[terminal];
+        auto const child_side_max = std::max(_terminal_distances[terminal][parent], max_cost_to_new[terminal]);
+        cost -= std::max(child_side_max, max_cost_to_new[parent]);
+        max_cost_to_new[parent] = std::min(child_side_max, max_cost_to_new[parent]);
+    }
     return cost;
 }
+
+template<TerminalIndex MaxTerminals>
+Cost OneTreeFutureCost<MaxTerminals>::compute_tree_cost(TerminalSubset<MaxTerminals> const& label) const {
+    // Prim's algorithm with an array of distances to the tree. The terminals not yet in the tree are kept in the
+    // prefix of terminals_to_connect of length num_to_connect.
+    std::array<TerminalIndex, MaxTerminals> terminals_to_connect{};
+    std::array<Cost, MaxTerminals> distance_to_tree{};
+    std::size_t num_to_connect = 0;
+    TerminalIndex last_connected = _grid.num_terminals() - 1;
+    assert(not label.test(last_connected));
+    for_each_set_bit(~label, _grid.num_terminals() - 1, [&](auto const set_bit) {
+        terminals_to_connect[num_to_connect] = set_bit;
+        distance_to_tree[num_to_connect] = _terminal_distances[last_connected][set_bit];
+        ++num_to_connect;
+    });
+    Cost cost = 0;
+    while (num_to_connect > 0) {
+        std::size_t closest = 0;
+        for (std::size_t i = 1; i < num_to_connect; ++i) {
+            if (distance_to_tree[i] < distance_to_tree[closest]) {
+                closest = i;
+            }
+        }
+        cost += distance_to_tree[closest];
+        last_connected = terminals_to_connect[closest];
+        --num_to_connect;
+        terminals_to_connect[closest] = terminals_to_connect[num_to_connect];
+        distance_to_tree[closest] = distance_to_tree[num_to_connect];
+        auto const& distances = _terminal_distances[last_connected];
+        for (std::size_t i = 0; i < num_to_connect; ++i) {
+            distance_to_tree[i] = std::min(distance_to_tree[i], distances[terminals_to_connect[i]]);
+        }
+    }
+    return cost;
+}
+
+// One instantiation for each of the terminal_widths
+template class OneTreeFutureCost<4>;
+template class OneTreeFutureCost<8>;
+template class OneTreeFutureCost<12>;
+template class OneTreeFutureCost<16>;
+template class OneTreeFutureCost<20>;
+template class OneTreeFutureCost<32>;
+template class OneTreeFutureCost<64>;
@@ -2,33 +2,96 @@
 #define MST_FUTURE_COST
 
 #include "FutureCost.h"
+#include <cstdint>
 #include <limits>
+#include <optional>
 #include <unordered_map>
 
 /**
  * Half of the cost of a 1-tree on the vertices not contained in a label and the special vertex as "1" (rounded up)
  * forms a valid future cost (Lemma 8 in arXiv:1406.0492)
+ * If the indexer is dense, precompute stores the MST costs for all subsets in a table indexed by the subset bitmask,
+ * so that operator() does not compute any MSTs. The table is filled by a depth-first enumeration of the trees, where
+ * each MST is obtained from a smaller one by inserting a single terminal in O(k) time. Otherwise the MST costs are
+ * computed when first needed and cached.
  */
+template<TerminalIndex MaxTerminals>
 class OneTreeFutureCost {
 public:
-    explicit OneTreeFutureCost(HananGrid const& grid, SubsetIndexer& indexer);
+    explicit OneTreeFutureCost(HananGrid<MaxTerminals> const& grid, SubsetIndexer<MaxTerminals>& indexer);
 
-    Cost operator()(Label const& label) const;
+    Cost operator()(Label<MaxTerminals> const& label) const;
+
+    void reset();
+
+    /// Fills the table of all MST costs if the indexer is dense, does nothing otherwise
+    void precompute(ThreadPool* thread_pool);
 
 private:
-    using SingleVertexDistances = HananGrid::SingleVertexDistances;
+    /// Minimum number of subsets per parallel task in precompute
+    static std::size_t constexpr min_subsets_per_task = 1024;
+
+    using SingleVertexDistances = typename HananGrid<MaxTerminals>::SingleVertexDistances;
+
+    /// A spanning tree on the root terminal and some of the other terminals, rooted at the root terminal
+    struct SpanningTree {
+        /// The terminals in the tree, each after its parent (so the root terminal is first)
+        std::array<TerminalIndex, MaxTerminals> order;
+        /// The parent of each terminal in the tree other than the root terminal
+        std::array<TerminalIndex, MaxTerminals> parent;
+        TerminalIndex size;
+        Cost cost;
+    };
+
+    /// An edge in insert_terminal: Either the edge from the new terminal to some terminal, or a tree edge
+    struct InsertionEdge {
+        Cost cost;
+        TerminalIndex terminal;
+        bool is_tree_edge;
+    };
+
+    /// Which edges of the given tree and at the new terminal are in the MST after inserting it, see insert_terminal
+    struct InsertionResult {
+        std::array<bool, MaxTerminals> keep_new_edge;
+        std::array<bool, MaxTerminals> keep_tree_edge;
+        Cost cost;
+    };
+
+    /**
+     * Only the tree edges and the edges at new_terminal can be in an MST on the terminals of the given MST and
+     * new_terminal, so each tree edge closes one cycle with them, whose most expensive edge is removed.
+     */
+    InsertionResult remove_cycle_maxima(SpanningTree const& tree, TerminalIndex new_terminal) const;
+
+    /// An MST on the terminals of the given MST and new_terminal
+    SpanningTree insert_terminal(SpanningTree const& tree, TerminalIndex new_terminal) const;
+
+    /// The cost of insert_terminal(tree, new_terminal), without constructing the tree
+    Cost get_insertion_cost(SpanningTree const& tree, TerminalIndex new_terminal) const;
+
+    /**
+     * Stores the cost of the given MST on the root terminal and tree_terminals, then recursively does the same for
+     * the trees obtained by inserting each terminal with an index less than next_terminal.
+     */
+    void fill_tree_costs(SpanningTree const& tree, std::uint64_t tree_terminals, TerminalIndex next_terminal);
 
-    Cost get_tree_cost(TerminalSubset const& not_contained_vertices) const;
+    /// The cost of an MST on the terminals not in the given subset
+    Cost get_tree_cost(TerminalSubset<MaxTerminals> const& label) const;
 
-    Cost compute_tree_cost(TerminalSubset const& not_contained_vertices) const;
+    /// Prim's algorithm on the complete graph of the terminals not in the given subset, without allocations
+    Cost compute_tree_cost(TerminalSubset<MaxTerminals> const& label) const;
 
-    HananGrid const& _grid;
+    HananGrid<MaxTerminals> const& _grid;
+    SubsetIndexer<MaxTerminals>& _indexer;
     /// Stores the distances between all pairs of terminals
-    std::array<SingleVertexDistances, max_num_terminals> _terminal_distances{};
-    /// Stores the known costs of MSTs on subsets of the terminal set
-    SubsetMap<Cost> mutable _known_tree_costs;
+    std::array<SingleVertexDistances, MaxTerminals> _terminal_distances{};
+    /// Stores the known costs of MSTs on subsets of the terminal set. Not present if the indexer is dense, since
+    /// _all_tree_costs is used then.
+    std::optional<SubsetMap<MaxTerminals, Cost>> mutable _known_tree_costs;
+    /// The MST costs for all subsets if precompute filled them, empty otherwise
+    std::vector<Cost> _all_tree_costs;
 };
 
-static_assert(FutureCost<OneTreeFutureCost>);
+static_assert(FutureCost<OneTreeFutureCost<max_num_terminals>, max_num_terminals>);
 
 #endif
@@ -1,21 +1,380 @@
 #include <iostream>
-#include "DijkstraSteiner.h"
-#include "future_costs/BBFutureCost.h"
-#include "future_costs/OneTreeFutureCost.h"
-#include "future_costs/MaxFutureCost.h"
+#include "SolverInstances.h"
+#include "SolverPortfolio.h"
+#include "BatchRunner.h"
+#include "ResultCache.h"
+#include <chrono>
+#include <exception>
+#include <filesystem>
 #include <fstream>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/**
+ * Calls function.template operator()<MaxTerminals>() for the smallest MaxTerminals in terminal_widths which is at
+ * least num_terminals, and returns the result
+ */
+template<std::size_t WidthIndex = 0, class Function>
+auto dispatch_terminal_width(std::size_t const num_terminals, Function const& function) {
+    TerminalIndex constexpr width = terminal_widths[WidthIndex];
+    if constexpr (WidthIndex + 1 == terminal_widths.size()) {
+        assert(num_terminals <= width);
+        return function.template operator()<width>();
+    } else {
+        if (num_terminals <= width) {
+            return function.template operator()<width>();
+        }
+        return dispatch_terminal_width<WidthIndex + 1>(num_terminals, function);
+    }
+}
+
+struct Options {
+    std::vector<std::filesystem::path> inputs;
+    bool report_memory = false;
+    /// Print the edges of an optimum tree after its cost
+    bool print_tree = false;
+    /// Threads used for a single instance
+    std::size_t num_threads = 1;
+    /// Number of solver configurations raced on a single instance, see solve_with_portfolio. 1 disables the portfolio.
+    std::size_t portfolio_size = 1;
+    /// Threads used for solving instances in parallel in batch mode
+    std::size_t num_jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    std::optional<std::filesystem::path> solutions_file;
+    FutureCostKind future_cost = FutureCostKind::max;
+    /// Limits for each instance, after which the best bounds found so far are reported
+    SearchLimits limits;
+    std::optional<std::chrono::steady_clock::duration> progress_interval;
+    /// Maximum number of entries of the result cache, which is used if this or cache_file is set
+    std::optional<std::size_t> cache_capacity;
+    /// Loaded into the result cache at the start if it exists, and replaced by its contents at the end
+    std::optional<std::filesystem::path> cache_file;
+};
+
+std::chrono::steady_clock::duration parse_seconds(char const* const value) {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(std::stod(value))
+    );
+}
+
+std::optional<Options> parse_options(int const argc, char** const argv) {
+    Options result;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view const option{argv[i]};
+        bool const has_value = i + 1 < argc;
+        if (option == "--report-memory") {
+            result.report_memory = true;
+        } else if (option == "--tree") {
+            result.print_tree = true;
+        } else if (option == "--threads" and has_value) {
+            result.num_threads = std::max(std::stoul(argv[++i]), 1ul);
+        } else if (option == "--portfolio" and has_value) {
+            result.portfolio_size = std::max(std::stoul(argv[++i]), 1ul);
+        } else if (option == "--jobs" and has_value) {
+            result.num_jobs = std::max(std::stoul(argv[++i]), 1ul);
+        } else if (option == "--solutions" and has_value) {
+            result.solutions_file = argv[++i];
+        } else if (option == "--time-limit" and has_value) {
+            result.limits.time = parse_seconds(argv[++i]);
+        } else if (option == "--label-limit" and has_value) {
+            result.limits.num_labels = std::stoul(argv[++i]);
+        } else if (option == "--progress" and has_value) {
+            result.progress_interval = parse_seconds(argv[++i]);
+        } else if (option == "--cache" and has_value) {
+            result.cache_capacity = std::stoul(argv[++i]);
+        } else if (option == "--cache-file" and has_value) {
+            result.cache_file = argv[++i];
+        } else if (option == "--future-cost" and has_value) {
+            std::string_view const name{argv[++i]};
+            auto const future_cost = parse_future_cost_kind(name);
+            if (not future_cost.has_value()) {
+                std::cerr << "Unknown future cost " << name << ", expected one of";
+                for (auto const known_name : future_cost_names) {
+                    std::cerr << ' ' << known_name;
+                }
+                std::cerr << '\n';
+                return std::nullopt;
+            }
+            result.future_cost = future_cost.value();
+        } else if (option.starts_with("--")) {
+            std::cerr << "Unknown option " << option << '\n';
+            return std::nullopt;
+        } else {
+            result.inputs.emplace_back(option);
+        }
+    }
+    if (result.inputs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <instance.sdtg> [--threads N | --portfolio N] [--report-memory] [--tree]"
+                  << " [--progress SECONDS]\n"
+                  << "       " << argv[0] << " <directory, list file or .sdtb file>... [--jobs N] [--solutions FILE]\n"
+                  << "Both modes accept [--time-limit SECONDS] [--label-limit N], after which the best upper bound"
+                  << " and the lower bound found so far are reported, and [--future-cost null|bb|one-tree|max]"
+                  << " (default max, ignored by --portfolio), and [--cache ENTRIES] [--cache-file FILE] to reuse the"
+                  << " optimum of instances equal up to translation, permutation and reflection of the axes.\n";
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::ostream& operator<<(std::ostream& out, Point const& point) {
+    for (std::size_t dimension = 0; dimension < num_dimensions; ++dimension) {
+        out << (dimension == 0 ? "" : " ") << point.at(dimension);
+    }
+    return out;
+}
+
+void print_tree_edges(std::vector<std::pair<Point, Point>> const& tree_edges) {
+    for (auto const& [from, to] : tree_edges) {
+        std::cout << from << " - " << to << '\n';
+    }
+}
+
+/**
+ * The result cache if the options enable it, with the entries of the cache file if it exists. If the file can't be
+ * loaded, the run continues without a cache, so that the file isn't replaced by the entries read before the error.
+ */
+std::unique_ptr<ResultCache> open_result_cache(Options const& options) {
+    if (not options.cache_capacity.has_value() and not options.cache_file.has_value()) {
+        return nullptr;
+    }
+    auto result = std::make_unique<ResultCache>(options.cache_capacity.value_or(ResultCache::default_capacity));
+    if (options.cache_file.has_value() and std::filesystem::exists(options.cache_file.value())) {
+        if (not result->load(options.cache_file.value())) {
+            std::cerr << "Running without result cache, so that " << options.cache_file.value()
+                      << " is not overwritten\n";
+            return nullptr;
+        }
+    }
+    return result;
+}
+
+/// Reports the hit rate of the cache and saves it to the cache file, returns false if saving failed
+bool close_result_cache(Options const& options, ResultCache const& cache) {
+    auto const stats = cache.get_stats();
+    std::cerr << "Result cache: " << stats.num_hits << " hits in " << stats.num_lookups << " lookups ("
+              << 100 * stats.hit_rate() << "%), " << stats.num_entries << " entries\n";
+    return not options.cache_file.has_value() or cache.save(options.cache_file.value());
+}
+
+/// Batch mode is used for directories, list files, binary instance files and multiple inputs
+bool is_batch(Options const& options) {
+    auto const& first = options.inputs.front();
+    return options.inputs.size() > 1 or std::filesystem::is_directory(first) or first.extension() != ".sdtg";
+}
+
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC>
+int solve_single(Options const& options, std::vector<Point> const& terminals, ResultCache* const cache) {
+    HananGrid<MaxTerminals> grid(terminals);
+    if (options.report_memory) {
+        auto const& distances = grid.get_distance_matrix();
+        std::cerr << "Hanan grid: " << grid.num_vertices() << " vertices, " << grid.num_removed_vertices()
+                  << " removed, distance matrix " << distances.allocated_bytes() << " bytes ("
+                  << (distances.is_narrow() ? 16 : 32) << " bit entries)\n";
+    }
+    Solver<MaxTerminals, FC> alg(
+        std::move(grid), SolverOptions{
+            .num_threads = options.num_threads, .reconstruct_tree = options.print_tree, .limits = options.limits,
+            .progress_interval = options.progress_interval
+        }
+    );
+    auto const bounds = alg.solve();
+    std::cout << bounds.upper_bound << '\n';
+    if (not alg.found_optimum()) {
+        std::cerr << "Limit reached: lower bound " << bounds.lower_bound << ", upper bound " << bounds.upper_bound
+                  << ", gap " << 100 * bounds.gap() << "%" << (options.print_tree ? ", no tree available" : "") << '\n';
+    } else {
+        std::optional<std::vector<std::pair<Point, Point>>> tree_edges;
+        if (options.print_tree) {
+            tree_edges = alg.get_tree_edges();
+            print_tree_edges(tree_edges.value());
+        }
+        if (cache != nullptr) {
+            cache->insert(terminals, {bounds.upper_bound, std::move(tree_edges)});
+        }
+    }
+    if constexpr (stats_enabled) {
+        alg.get_stats().write_json(std::cerr);
+        std::cerr << '\n';
+    }
+    if (options.report_memory) {
+        auto const label_memory = alg.get_label_memory();
+        auto const num_labels = alg.get_num_labels();
+        std::cerr << "Label memory: " << label_memory << " bytes for " << num_labels << " labels ("
+                  << static_cast<double>(label_memory) / static_cast<double>(std::max<std::size_t>(num_labels, 1))
+                  << " bytes per label)\n";
+        if (options.print_tree) {
+            std::cerr << "Predecessor memory: " << alg.get_predecessor_memory() << " bytes\n";
+        }
+    }
+    return 0;
+}
+
+/// Races options.portfolio_size configurations of the solver, see solve_with_portfolio
+template<TerminalIndex MaxTerminals>
+int solve_single_with_portfolio(
+    Options const& options, std::vector<Point> const& terminals, ResultCache* const cache
+) {
+    auto const configurations = get_portfolio_configurations(terminals.size(), options.portfolio_size);
+    auto const result = solve_with_portfolio<MaxTerminals>(
+        terminals, configurations, SolverOptions{
+            .reconstruct_tree = options.print_tree, .limits = options.limits,
+            .progress_interval = options.progress_interval
+        }
+    );
+    std::cout << result.bounds.upper_bound << '\n';
+    if (not result.winner.has_value()) {
+        std::cerr << "Limit reached: lower bound " << result.bounds.lower_bound << ", upper bound "
+                  << result.bounds.upper_bound << ", gap " << 100 * result.bounds.gap() << "%"
+                  << (options.print_tree ? ", no tree available" : "") << '\n';
+        return 0;
+    }
+    auto const& winner = configurations.at(result.winner.value());
+    std::cerr << "Portfolio: configuration " << result.winner.value() << " (future cost "
+              << future_cost_names.at(static_cast<std::size_t>(winner.future_cost)) << ", root terminal "
+              << winner.root_terminal << ") finished first\n";
+    print_tree_edges(result.tree_edges);
+    if (cache != nullptr) {
+        cache->insert(
+            terminals, {
+                result.bounds.upper_bound,
+                options.print_tree ? std::optional(result.tree_edges) : std::nullopt
+            }
+        );
+    }
+    return 0;
+}
+
+int solve_single(Options const& options) {
+    std::ifstream in(options.inputs.front());
+    auto const terminals = read_terminals(in);
+    in.close();
+    if (not terminals.has_value()) {
+        return 1;
+    }
+    auto const cache = open_result_cache(options);
+    if (cache != nullptr) {
+        auto const cached = cache->lookup(terminals.value());
+        if (cached.has_value() and (not options.print_tree or cached->tree_edges.has_value())) {
+            std::cout << cached->cost << '\n';
+            if (options.print_tree) {
+                print_tree_edges(cached->tree_edges.value());
+            }
+            return close_result_cache(options, *cache) ? 0 : 1;
+        }
+    }
+    auto const result = dispatch_terminal_width(
+        terminals->size(), [&]<TerminalIndex MaxTerminals>() {
+            if (options.portfolio_size > 1) {
+                return solve_single_with_portfolio<MaxTerminals>(options, terminals.value(), cache.get());
+            }
+            return dispatch_future_cost<MaxTerminals>(
+                options.future_cost, [&]<FutureCost<MaxTerminals> FC>() {
+                    return solve_single<MaxTerminals, FC>(options, terminals.value(), cache.get());
+                }
+            );
+        }
+    );
+    if (cache != nullptr and not close_result_cache(options, *cache)) {
+        return 1;
+    }
+    return result;
+}
+
+/**
+ * Solves one instance of a batch. Each thread reuses one solver per width and future cost, so its memory is only
+ * allocated once.
+ */
+template<TerminalIndex MaxTerminals, FutureCost<MaxTerminals> FC>
+BatchRunner::SolverResult solve_batch_instance(
+    Options const& options, std::vector<Point> const& terminals, SearchStats& total_stats, std::mutex& stats_mutex
+) {
+    thread_local std::optional<Solver<MaxTerminals, FC>> alg;
+    if (alg.has_value()) {
+        alg->reset(terminals);
+    } else {
+        alg.emplace(HananGrid<MaxTerminals>(terminals), SolverOptions{.limits = options.limits});
+    }
+    auto const bounds = alg->solve();
+    if constexpr (stats_enabled) {
+        std::scoped_lock const lock(stats_mutex);
+        total_stats.merge(alg->get_stats());
+    }
+    return BatchRunner::SolverResult{bounds.upper_bound, bounds.lower_bound, alg->get_label_memory()};
+}
+
+int solve_batch(Options const& options) {
+    // Statistics summed over all instances
+    SearchStats total_stats;
+    std::mutex total_stats_mutex;
+    auto const cache = open_result_cache(options);
+    BatchRunner runner(
+        [&](std::vector<Point> const& terminals) {
+            if (cache != nullptr) {
+                if (auto const cached = cache->lookup(terminals)) {
+                    return BatchRunner::SolverResult{cached->cost, cached->cost, 0};
+                }
+            }
+            auto const result = dispatch_terminal_width(
+                terminals.size(), [&]<TerminalIndex MaxTerminals>() {
+                    return dispatch_future_cost<MaxTerminals>(
+                        options.future_cost, [&]<FutureCost<MaxTerminals> FC>() {
+                            return solve_batch_instance<MaxTerminals, FC>(
+                                options, terminals, total_stats, total_stats_mutex
+                            );
+                        }
+                    );
+                }
+            );
+            if (cache != nullptr and result.lower_bound == result.cost) {
+                cache->insert(terminals, {result.cost});
+            }
+            return result;
+        }, options.num_jobs
+    );
+    if (options.solutions_file.has_value()) {
+        runner.read_solutions(options.solutions_file.value());
+    }
+    std::vector<BatchRunner::Instance> instances;
+    for (auto const& input : options.inputs) {
+        auto const collected = BatchRunner::collect_instances(input);
+        if (not collected.has_value()) {
+            return 1;
+        }
+        instances.insert(instances.end(), collected->begin(), collected->end());
+    }
+    auto success = runner.run(instances, std::cout);
+    if constexpr (stats_enabled) {
+        total_stats.write_json(std::cerr);
+        std::cerr << '\n';
+    }
+    if (cache != nullptr) {
+        success &= close_result_cache(options, *cache);
+    }
+    return success ? 0 : 1;
+}
+
+}
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
+    auto const options = parse_options(argc, argv);
+    if (not options.has_value()) {
         return 1;
     }
-    std::ifstream in(argv[1]);
-    auto const optional_grid = HananGrid::read_from_stream(in);
-    in.close();
-    if (not optional_grid.has_value()) {
+    try {
+        if (is_batch(options.value())) {
+            return solve_batch(options.value());
+        }
+        return solve_single(options.value());
+    } catch (std::exception const& exception) {
+        std::cerr << "Failed to solve: " << exception.what() << '\n';
         return 1;
     }
-    DijkstraSteiner<MaxFutureCost<OneTreeFutureCost, BBFutureCost>> alg(optional_grid.value());
-    auto const cost = alg.get_optimum_cost();
-    std::cout << cost << '\n';
 }
@@ -0,0 +1,47 @@
+#ifndef BINARY_HEAP_QUEUE_H
+#define BINARY_HEAP_QUEUE_H
+
+#include "LabelQueue.h"
+#include <algorithm>
+
+/// Comparison-based binary heap, works for any (not necessarily monotone) sequence of keys
+template<QueueEntry Entry>
+class BinaryHeapQueue {
+public:
+    using value_type = Entry;
+
+    void push(Entry const& entry) {
+        _heap.push_back(entry);
+        std::push_heap(_heap.begin(), _heap.end(), ByKey{});
+    }
+
+    Entry extract_min() {
+        std::pop_heap(_heap.begin(), _heap.end(), ByKey{});
+        auto const result = _heap.back();
+        _heap.pop_back();
+        return result;
+    }
+
+    void extract_all_min(std::vector<Entry>& out) {
+        auto const min_key = _heap.front().key();
+        while (not _heap.empty() and _heap.front().key() == min_key) {
+            out.push_back(extract_min());
+        }
+    }
+
+    void clear() { _heap.clear(); }
+
+    [[nodiscard]] bool empty() const { return _heap.empty(); }
+
+    [[nodiscard]] std::size_t size() const { return _heap.size(); }
+
+private:
+    /// Orders entries such that the standard heap algorithms produce a min-heap
+    struct ByKey {
+        bool operator()(Entry const& a, Entry const& b) const { return a.key() > b.key(); }
+    };
+
+    std::vector<Entry> _heap;
+};
+
+#endif
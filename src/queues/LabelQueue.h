@@ -0,0 +1,30 @@
+#ifndef LABEL_QUEUE_H
+#define LABEL_QUEUE_H
+
+#include "../TypeDefs.h"
+#include <vector>
+
+/// An element of a LabelQueue. The queue only needs to know the key (i.e. the cost lower bound) of an entry.
+template<typename E>
+concept QueueEntry = std::is_copy_constructible_v<E> and requires(E const e) {
+    { e.key() } -> std::convertible_to<Cost>;
+};
+
+/**
+ * A min-priority queue for the labels in DijkstraSteiner. extract_min returns some entry with minimum key and removes
+ * it from the queue, extract_all_min moves all entries with the minimum key to the end of the given vector. clear
+ * removes all entries and should keep allocated memory for reuse.
+ */
+template<typename Q>
+concept LabelQueue = requires(
+    Q q, Q const const_q, typename Q::value_type entry, std::vector<typename Q::value_type> out
+) {
+    q.push(entry);
+    { q.extract_min() } -> std::convertible_to<typename Q::value_type>;
+    q.extract_all_min(out);
+    q.clear();
+    { const_q.empty() } -> std::convertible_to<bool>;
+    { const_q.size() } -> std::convertible_to<std::size_t>;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef RADIX_HEAP_QUEUE_H
+#define RADIX_HEAP_QUEUE_H
+
+#include "LabelQueue.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+/**
+ * Monotone radix heap (Ahuja, Mehlhorn, Orlin, Tarjan). Bucket i > 0 holds the entries whose key differs from the last
+ * extracted key first in bit i - 1 (counting from the least significant bit), bucket 0 holds entries with exactly the
+ * last extracted key. Each entry is moved to a lower bucket at most once per bit of Cost, so push and extract_min take
+ * amortized O(1) time for a fixed key width.
+ * This requires the keys to be monotone, i.e. no key pushed may be less than the last extracted key. This holds in
+ * DijkstraSteiner since all future costs are consistent.
+ */
+template<QueueEntry Entry>
+class RadixHeapQueue {
+public:
+    using value_type = Entry;
+
+    void push(Entry const& entry);
+
+    Entry extract_min();
+
+    void extract_all_min(std::vector<Entry>& out);
+
+    void clear();
+
+    [[nodiscard]] bool empty() const { return _size == 0; }
+
+    [[nodiscard]] std::size_t size() const { return _size; }
+
+private:
+    [[nodiscard]] std::size_t bucket_index(Cost key) const;
+
+    /// Moves the entries of the first non-empty bucket to lower buckets, making bucket 0 non-empty
+    void redistribute();
+
+    std::array<std::vector<Entry>, std::numeric_limits<Cost>::digits + 1> _buckets;
+    Cost _last_key = 0;
+    std::size_t _size = 0;
+};
+
+template<QueueEntry Entry>
+void RadixHeapQueue<Entry>::push(Entry const& entry) {
+    _buckets[bucket_index(entry.key())].push_back(entry);
+    ++_size;
+}
+
+template<QueueEntry Entry>
+Entry RadixHeapQueue<Entry>::extract_min() {
+    assert(not empty());
+    if (_buckets[0].empty()) {
+        redistribute();
+    }
+    auto const result = _buckets[0].back();
+    _buckets[0].pop_back();
+    --_size;
+    return result;
+}
+
+template<QueueEntry Entry>
+void RadixHeapQueue<Entry>::extract_all_min(std::vector<Entry>& out) {
+    assert(not empty());
+    if (_buckets[0].empty()) {
+        redistribute();
+    }
+    out.insert(out.end(), _buckets[0].begin(), _buckets[0].end());
+    _size -= _buckets[0].size();
+    _buckets[0].clear();
+}
+
+template<QueueEntry Entry>
+void RadixHeapQueue<Entry>::clear() {
+    for (auto& bucket : _buckets) {
+        bucket.clear();
+    }
+    _last_key = 0;
+    _size = 0;
+}
+
+template<QueueEntry Entry>
+std::size_t RadixHeapQueue<Entry>::bucket_index(Cost const key) const {
+    assert(key >= _last_key);
+    // Keys equal to the last extracted key have no differing bit and go to bucket 0
+    return std::bit_width(key ^ _last_key);
+}
+
+template<QueueEntry Entry>
+void RadixHeapQueue<Entry>::redistribute() {
+    auto const bucket_it = std::find_if(
+        _buckets.begin() + 1, _buckets.end(), [](auto const& bucket) { return not bucket.empty(); }
+    );
+    assert(bucket_it != _buckets.end());
+    auto& bucket = *bucket_it;
+    _last_key = std::min_element(
+        bucket.begin(), bucket.end(), [](Entry const& a, Entry const& b) { return a.key() < b.key(); }
+    )->key();
+    // All entries of the bucket go to strictly lower buckets, so we never append to the bucket we are reading from
+    for (auto const& entry : bucket) {
+        _buckets[bucket_index(entry.key())].push_back(entry);
+    }
+    bucket.clear();
+}
+
+#endif
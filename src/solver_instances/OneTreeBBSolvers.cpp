@@ -0,0 +1,3 @@
+#include "../SolverInstances.h"
+
+SOLVER_INSTANCES(, OneTreeBBFutureCost)